@@ -2,6 +2,12 @@
 
 using namespace llvm;
 
+// Embed a ThinLTO summary, which lets the analyzer build its global
+// tables without parsing function bodies (-use-summary)
+static cl::opt<bool> DumpSummary("irdumper-summary",
+		cl::desc("Write a module summary into the dumped bitcode"),
+		cl::init(false));
+
 
 void saveModule(Module &M, Twine filename)
 {
@@ -16,7 +22,13 @@ void saveModule(Module &M, Twine filename)
 	sys::fs::openFileForWrite(
 			FN.take_front(FN.size() - 2) + ".bc", bc_fd);
 	raw_fd_ostream bc_file(bc_fd, true, true);
-	WriteBitcodeToFile(M, bc_file);
+	if (DumpSummary) {
+		ProfileSummaryInfo PSI(M);
+		ModuleSummaryIndex Index = buildModuleSummaryIndex(M, nullptr, &PSI);
+		WriteBitcodeToFile(M, bc_file, false, &Index);
+	}
+	else
+		WriteBitcodeToFile(M, bc_file);
 }
 
 bool LegacyIRDumper::runOnModule(Module &M) {
@@ -11,6 +11,8 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/ModuleSummaryIndex.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/ToolOutputFile.h"
@@ -47,9 +49,91 @@ cl::opt<int> MLTA(
     targets"),
   cl::NotHidden, cl::init(2));
 
+cl::opt<bool> UseSummary(
+    "use-summary",
+  cl::desc("Build the global tables from ThinLTO module summaries \
+    and load function bodies lazily (all are materialized before the \
+    analysis, so peak memory is unchanged)"),
+  cl::NotHidden, cl::init(false));
+
+cl::opt<unsigned long long> HashSeed(
+    "hash-seed",
+  cl::desc("Seed of the stable type and signature hashes"),
+  cl::NotHidden, cl::init(0));
+
+cl::opt<bool> HashAudit(
+    "hash-audit",
+  cl::desc("Record the type behind every hash and report hash \
+    collisions"),
+  cl::NotHidden, cl::init(false));
+
+cl::opt<bool> TypeTableStats(
+    "type-table-stats",
+  cl::desc("Report the memory of the type tables and the lookup \
+    throughput of the type-layer resolution"),
+  cl::NotHidden, cl::init(false));
+
 GlobalContext GlobalCtx;
 
 
+// Lazily load a bitcode file that carries a ThinLTO summary (e.g.,
+// built with -flto=thin) and collect the GUIDs referenced by the
+// module, i.e., the ones whose addresses are taken, and the callees
+// of its call edges that are not referenced. Function bodies are not
+// parsed here. Returns NULL if the file has no summary.
+static std::unique_ptr<Module> loadModuleWithSummary(
+		const std::string &FileName, LLVMContext &LLVMCtx,
+		DenseSet<uint64_t> &RefGUIDs, DenseSet<uint64_t> &CallGUIDs) {
+
+	ErrorOr<std::unique_ptr<MemoryBuffer>> BufOrErr =
+		MemoryBuffer::getFile(FileName);
+	if (!BufOrErr)
+		return NULL;
+	std::unique_ptr<MemoryBuffer> Buf = std::move(*BufOrErr);
+
+	Expected<BitcodeLTOInfo> LTOInfo =
+		getBitcodeLTOInfo(Buf->getMemBufferRef());
+	if (!LTOInfo) {
+		consumeError(LTOInfo.takeError());
+		return NULL;
+	}
+	if (!LTOInfo->HasSummary)
+		return NULL;
+
+	Expected<std::unique_ptr<ModuleSummaryIndex>> Index =
+		getModuleSummaryIndex(Buf->getMemBufferRef());
+	if (!Index) {
+		consumeError(Index.takeError());
+		return NULL;
+	}
+
+	// Reference edges of functions and global variables. A call
+	// through a cast callee may only be recorded as a call edge, so
+	// the callees are kept for a check against the bodies
+	for (auto &GVS : **Index) {
+		for (auto &S : GVS.second.SummaryList) {
+			for (ValueInfo VI : S->refs())
+				RefGUIDs.insert(VI.getGUID());
+			if (FunctionSummary *FS = dyn_cast<FunctionSummary>(S.get())) {
+				for (auto &CE : FS->calls())
+					CallGUIDs.insert(CE.first.getGUID());
+			}
+		}
+	}
+	for (uint64_t GUID : RefGUIDs)
+		CallGUIDs.erase(GUID);
+
+	Expected<std::unique_ptr<Module>> M =
+		getOwningLazyBitcodeModule(std::move(Buf), LLVMCtx);
+	if (!M) {
+		consumeError(M.takeError());
+		return NULL;
+	}
+
+	return std::move(*M);
+}
+
+
 void IterativeModulePass::run(ModuleList &modules) {
 
 	ModuleList::iterator i, e;
@@ -100,26 +184,24 @@ void IterativeModulePass::run(ModuleList &modules) {
 
 void PrintResults(GlobalContext *GCtx) {
 
+	unsigned NumIndirectCalls = 0;
 	int TotalTargets = 0;
-	for (auto IC : GCtx->IndirectCallInsts) {
-		TotalTargets += GCtx->Callees[IC].size();
+	CallSiteTable &CS = GCtx->CallSites;
+	for (unsigned i = 0; i < CS.size(); ++i) {
+		if (!CS.is(i, CS_INDIRECT))
+			continue;
+		++NumIndirectCalls;
+		TotalTargets += GCtx->TargetSets.get(CS.getTargetSet(i)).size();
 	}
 	float AveIndirectTargets = 0.0;
 	if (GCtx->NumValidIndirectCalls)
 		AveIndirectTargets =
-			(float)GCtx->NumIndirectCallTargets/GCtx->IndirectCallInsts.size();
-
-	int totalsize = 0;
-	for (auto &curEle: GCtx->Callees) {
-		if (curEle.first->isIndirectCall()) {
-			totalsize += curEle.second.size();
-		}
-	}
+			(float)GCtx->NumIndirectCallTargets/NumIndirectCalls;
 
 	// OP << "\n@@ Total number of final callees: " << totalsize << ".\n";
 	OP<<"############## Result Statistics ##############\n";
 	//cout<<"# Ave. Number of indirect-call targets: \t"<<std::setprecision(5)<<AveIndirectTargets<<"\n";
-	OP<<"# Number of indirect calls: \t\t\t"<<GCtx->IndirectCallInsts.size()<<"\n";   
+	OP<<"# Number of indirect calls: \t\t\t"<<NumIndirectCalls<<"\n";   
 	// OP<<"# Number of indirect calls with targets: \t"<<GCtx->NumValidIndirectCalls<<"\n";
 	OP<<"# Number of indirect-call targets: \t\t"<<GCtx->NumIndirectCallTargets<<"\n";
 	// OP<<"# Number of address-taken functions: \t\t"<<GCtx->AddressTakenFuncs.size()<<"\n";
@@ -127,6 +209,23 @@ void PrintResults(GlobalContext *GCtx) {
 	// OP<<"# Number of multi-layer targets: \t\t"<<GCtx->NumSecondLayerTargets<<"\n";  
 	// OP<<"# Number of one-layer calls: \t\t\t"<<GCtx->NumFirstLayerTypeCalls<<"\n";
 	// OP<<"# Number of one-layer targets: \t\t\t"<<GCtx->NumFirstLayerTargets<<"\n";
+
+	if (TypeTableStats) {
+		OP<<"############## Type-Table Statistics ##############\n";
+		OP<<"# Phase-1 table memory (bytes): \t\t"<<GCtx->TypeTableMemory<<"\n";
+		OP<<"# Frozen table memory (bytes): \t\t"<<GCtx->FrozenTypeTableMemory<<"\n";
+		OP<<"# Number of table lookups: \t\t\t"<<GCtx->NumTypeTableLookups<<"\n";
+		OP<<"# Number of table hits: \t\t\t"<<GCtx->NumTypeTableHits<<"\n";
+		OP<<"# Target-set copies in resolution: \t\t"<<GCtx->NumResolutionSetCopies
+			<<" (max "<<GCtx->MaxResolutionSetCopies<<" per call)\n";
+		OP<<"# Type-chain walks: \t\t\t"<<GCtx->NumTypeWalks
+			<<" ("<<GCtx->NumTypeWalkSpills<<" allocating, "
+			<<GCtx->NumTypeWalkMemoHits<<" memoized)\n";
+		OP<<"# Layer resolution time (s): \t\t"<<GCtx->TypeTableLookupTime<<"\n";
+		if (GCtx->TypeTableLookupTime > 0)
+			OP<<"# Lookups per second: \t\t\t"
+				<<(uint64_t)(GCtx->NumTypeTableLookups/GCtx->TypeTableLookupTime)<<"\n";
+	}
 }
 
 int main(int argc, char **argv) {
@@ -146,7 +245,18 @@ int main(int argc, char **argv) {
 	for (unsigned i = 0; i < InputFilenames.size(); ++i) {
 
 		LLVMContext *LLVMCtx = new LLVMContext();
-		std::unique_ptr<Module> M = parseIRFile(InputFilenames[i], Err, *LLVMCtx);
+		std::unique_ptr<Module> M;
+		DenseSet<uint64_t> RefGUIDs, CallGUIDs;
+		bool HasSummary = false;
+
+		if (UseSummary) {
+			M = loadModuleWithSummary(InputFilenames[i], *LLVMCtx,
+					RefGUIDs, CallGUIDs);
+			HasSummary = (M != NULL);
+		}
+		// Files without a summary are fully parsed
+		if (M == NULL)
+			M = parseIRFile(InputFilenames[i], Err, *LLVMCtx);
 
 		if (M == NULL) {
 			OP << argv[0] << ": error loading file '"
@@ -158,6 +268,10 @@ int main(int argc, char **argv) {
 		StringRef MName = StringRef(strdup(InputFilenames[i].data()));
 		GlobalCtx.Modules.push_back(std::make_pair(Module, MName));
 		GlobalCtx.ModuleMaps[Module] = InputFilenames[i];
+		if (HasSummary) {
+			GlobalCtx.ModuleSummaryRefs[Module] = std::move(RefGUIDs);
+			GlobalCtx.ModuleSummaryCallees[Module] = std::move(CallGUIDs);
+		}
 	}
 
 	//
@@ -173,6 +287,9 @@ int main(int argc, char **argv) {
 	// Print final results
 	PrintResults(&GlobalCtx);
 
+	if (HashAudit)
+		reportHashAudit();
+
 	return 0;
 }
 
@@ -5,6 +5,7 @@
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
 #include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/ADT/StringExtras.h>
 #include <llvm/Support/Path.h>
@@ -21,6 +22,11 @@
 #include <string>
 
 #include "Common.h"
+#include "PerfectHash.h"
+#include "IDBitmap.h"
+#include "TargetSetStore.h"
+#include "CallSiteTable.h"
+#include "CallGraphIndex.h"
 
 
 // 
@@ -32,8 +38,6 @@ typedef std::unordered_map<llvm::Module*, llvm::StringRef> ModuleNameMap;
 // The set of all functions.
 typedef llvm::SmallPtrSet<llvm::Function*, 8> FuncSet;
 typedef llvm::SmallPtrSet<llvm::CallInst*, 8> CallInstSet;
-typedef DenseMap<Function*, CallInstSet> CallerMap;
-typedef DenseMap<CallInst *, FuncSet> CalleeMap;
 
 struct GlobalContext {
 
@@ -48,32 +52,62 @@ struct GlobalContext {
 	unsigned NumIndirectCallTargets = 0;
 	unsigned NumFirstLayerTargets = 0;
 
+	// Type-table statistics, reported with -type-table-stats
+	size_t TypeTableMemory = 0;
+	size_t FrozenTypeTableMemory = 0;
+	unsigned long NumTypeTableLookups = 0;
+	unsigned long NumTypeTableHits = 0;
+	double TypeTableLookupTime = 0;
+	// Whole target sets copied by the layer resolution
+	unsigned long NumResolutionSetCopies = 0;
+	unsigned MaxResolutionSetCopies = 0;
+	// Type-chain walks, and those that outgrew their inline storage
+	unsigned long NumTypeWalks = 0;
+	unsigned long NumTypeWalkSpills = 0;
+	// Walks answered by the per-function memo
+	unsigned long NumTypeWalkMemoHits = 0;
+
 	// Global variables
 	DenseMap<size_t, GlobalVariable *>Globals;
 	
 	// Map global function GUID (uint64_t) to its actual function with body.
-	map<uint64_t, Function*> GlobalFuncMap;
+	// It is built once by symbol resolution before the analysis starts.
+	FrozenMap<Function*> GlobalFuncMap;
 
 	// Functions whose addresses are taken.
 	FuncSet AddressTakenFuncs;
 
-	// Map a callsite to all potential callee functions.
-	CalleeMap Callees;
+	// All callsites, with their potential callee functions. The sets
+	// are shared through TargetSets; their members are function IDs.
+	CallSiteTable CallSites;
+	TargetSetStore TargetSets;
 
-	// Map a function to all potential caller instructions.
-	CallerMap Callers;
+	// Forward and reverse call graph, built after resolution.
+	CallGraphIndex CG;
 
-	// Map function signature to functions
-	DenseMap<size_t, FuncSet>sigFuncsMap;
+	// Dense IDs of the functions that can be targets. Target sets
+	// inside the analysis are bitmaps of these IDs.
+	vector<Function *>IDFuncs;
+	DenseMap<Function *, unsigned>FuncIDs;
 
-	// Indirect call instructions.
-	std::vector<CallInst *>IndirectCallInsts;
+	// Map function signature to functions, indexed by the signature
+	// ID assigned by MLTA. It is only filled in phase 1.
+	vector<IDBitmap>sigFuncsMap;
 
 	// Modules.
 	ModuleList Modules;
 	ModuleNameMap ModuleMaps;
 	std::set<std::string> InvolvedModules;
 
+	// GUIDs whose addresses are taken in a module, from its ThinLTO
+	// summary. Only modules loaded lazily with a summary are included;
+	// their function bodies are materialized after the global prepass.
+	DenseMap<Module*, DenseSet<uint64_t>> ModuleSummaryRefs;
+	// Callees of the summary call edges of the same modules that are
+	// not referenced; they are address-taken only if called through a
+	// cast, which Function::hasAddressTaken() decides on the bodies
+	DenseMap<Module*, DenseSet<uint64_t>> ModuleSummaryCallees;
+
 };
 
 class IterativeModulePass {
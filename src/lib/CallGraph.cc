@@ -20,12 +20,12 @@
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/Support/raw_ostream.h"  
 #include "llvm/IR/InstrTypes.h" 
-#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h" 
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/CFG.h" 
+#include "llvm/Support/ThreadPool.h"
 
 #include "Common.h"
 #include "CallGraph.h"
@@ -42,20 +42,17 @@ using namespace llvm;
 
 void CallGraphPass::doMLTA(Function *F) {
 
-  // Unroll loops
-#ifdef UNROLL_LOOP_ONCE
-  unrollLoops(F);
-#endif
-
   // Collect callers and callees
   for (inst_iterator i = inst_begin(F), e = inst_end(F);
 			i != e; ++i) {
 		// Map callsite to possible callees.
 		if (CallInst *CI = dyn_cast<CallInst>(&*i)) {
 
-			CallSet.insert(CI);
-
-			FuncSet *FS = &Ctx->Callees[CI];
+			unsigned SetID = 0;
+			unsigned SigID = callSigID(CI);
+			unsigned Site = Ctx->CallSites.add(CI,
+					CI->isIndirectCall() ? CS_INDIRECT : CS_DIRECT,
+					SigID, getFuncID(F));
 			Value *CV = CI->getCalledOperand();
 			Function *CF = dyn_cast<Function>(CV);
 
@@ -64,54 +61,37 @@ void CallGraphPass::doMLTA(Function *F) {
 
 				// Multi-layer type matching
 				if (ENABLE_MLTA > 1) {
-					findCalleesWithMLTA(CI, *FS);
+					SetID = findCalleesWithMLTA(CI);
 				}
 				// Fuzzy type matching
 				else if (ENABLE_MLTA == 0) {
-					size_t CIH = callHash(CI);
-					if (MatchedICallTypeMap.find(CIH)
-							!= MatchedICallTypeMap.end())
-						*FS = MatchedICallTypeMap[CIH];
-					else {
-						findCalleesWithType(CI, *FS);
-						MatchedICallTypeMap[CIH] = *FS;
-					}
+					SetID = findCalleesWithType(CI);
 				}
 				// One-layer type matching
 				else {
-					*FS = Ctx->sigFuncsMap[callHash(CI)];
-				}
-
-#ifdef MAP_CALLER_TO_CALLEE
-				for (Function *Callee : *FS) {
-					Ctx->Callers[Callee].insert(CI);
+					SetID = getSigTargetSet(SigID);
 				}
-#endif
-				// Save called values for future uses.
-				Ctx->IndirectCallInsts.push_back(CI);
+				Ctx->CallSites.setTargetSet(Site, SetID);
+				const IDBitmap &FS = Ctx->TargetSets.get(SetID);
 
-				ICallSet.insert(CI);
-				if (!FS->empty()) {
-					MatchedICallSet.insert(CI);
-					Ctx->NumIndirectCallTargets += FS->size();
+				if (!FS.empty()) {
+					Ctx->CallSites.addKind(Site, CS_MATCHED);
+					Ctx->NumIndirectCallTargets += FS.size();
 					Ctx->NumValidIndirectCalls++;
 				}
+				if (SetID == getSigTargetSet(SigID))
+					Ctx->CallSites.addKind(Site, CS_FALLBACK);
 			}
 			// Direct call
 			else {
 				// not InlineAsm
 				if (CF) {
-					// Call external functions
-					if (CF->isDeclaration()) {
-						if (Function *GF = Ctx->GlobalFuncMap[CF->getGUID()])
-							CF = GF;
-					}
-
-					FS->insert(CF);
+					// Call external functions; a function defined in no
+					// loaded module stays the declaration
+					if (Function *DF = getFuncDefinition(CF))
+						CF = DF;
 
-#ifdef MAP_CALLER_TO_CALLEE
-					Ctx->Callers[CF].insert(CI);
-#endif
+					Ctx->CallSites.setCallee(Site, getFuncID(CF));
 				}
 				// InlineAsm
 				else {
@@ -124,24 +104,22 @@ void CallGraphPass::doMLTA(Function *F) {
 
 #ifdef PRINT_ICALL_TARGET
 					printSourceCodeInfo(CI, "RESOLVING");
-#endif
 
-					//FuncSet FSBase = Ctx->sigFuncsMap[callHash(CI)];
+					//FuncSet FSBase = getSigFuncs(callSigID(CI));
 					//if (LayerNo > 0) {
-					for (auto F : Ctx->sigFuncsMap[callHash(CI)]) {
-						if (FS->find(F) == FS->end()) {
-#ifdef PRINT_ICALL_TARGET
+					const IDBitmap &FS = Ctx->TargetSets.get(SetID);
+					getSigFuncs(SigID).forEach([&](uint32_t ID) {
+						Function *F = getFuncByID(ID);
+						if (!FS.contains(ID)) {
 							if ((OutScopeFuncs.find(F) == OutScopeFuncs.end())
 									&& (StoredFuncs.find(F) != StoredFuncs.end())) {
 								printSourceCodeInfo(F, "REMOVED");
 							}
 							else {
 							}
-#endif
 						}
-					}
-#ifdef PRINT_ICALL_TARGET
-					printTargets(*FS, CI);
+					});
+					printTargets(FS, CI);
 #endif
 				}
 				}
@@ -149,6 +127,79 @@ void CallGraphPass::doMLTA(Function *F) {
 		}
 	}
 
+void CallGraphPass::collectAddressTakenFunc(Function *F) {
+
+	Ctx->AddressTakenFuncs.insert(F);
+	unsigned SigID = funcSigID(F);
+	if (SigID >= Ctx->sigFuncsMap.size())
+		Ctx->sigFuncsMap.resize(SigID + 1);
+	if (Function *DF = getFuncDefinition(F))
+		Ctx->sigFuncsMap[SigID].insert(getFuncID(DF));
+	StringRef FName = F->getName();
+	if (FName.startswith("__x64") ||
+			FName.startswith("__ia32")) {
+		OutScopeFuncs.insert(F);
+	}
+}
+
+// Collect address-taken functions and their signatures for modules
+// loaded with a ThinLTO summary. A function is address-taken if the
+// summary of its module has a reference edge to it. Only the callees
+// of call edges without one are checked with hasAddressTaken(), as
+// the other modules do, so that both agree on casted callees; this
+// needs the bodies to be materialized.
+void CallGraphPass::collectSummaryGlobalFacts() {
+
+	for (auto &MP : Ctx->Modules) {
+		Module *M = MP.first;
+		auto it = Ctx->ModuleSummaryRefs.find(M);
+		if (it == Ctx->ModuleSummaryRefs.end())
+			continue;
+		const DenseSet<uint64_t> &Callees = Ctx->ModuleSummaryCallees[M];
+
+		for (Function &F : *M) {
+			if (F.isIntrinsic())
+				continue;
+			uint64_t GUID = F.getGUID();
+			if (it->second.count(GUID)
+					|| (Callees.count(GUID) && F.hasAddressTaken()))
+				collectAddressTakenFunc(&F);
+		}
+	}
+}
+
+// Materialize the function bodies of lazily loaded modules for the
+// confinement and resolution. All of them are needed before the
+// first module is initialized, as the confinement follows callee
+// arguments into other modules; the peak memory is thus the same as
+// without summaries. Every module has its own context, so this is
+// done in parallel.
+void CallGraphPass::materializeModules() {
+
+	ModuleList &Modules = Ctx->Modules;
+	vector<string> Errors(Modules.size());
+
+	ThreadPool Pool;
+	for (unsigned i = 0; i < Modules.size(); ++i) {
+		Module *M = Modules[i].first;
+		if (!Ctx->ModuleSummaryRefs.count(M))
+			continue;
+
+		string *ErrStr = &Errors[i];
+		Pool.async([M, ErrStr]() {
+			if (Error E = M->materializeAll())
+				*ErrStr = toString(std::move(E));
+		});
+	}
+	Pool.wait();
+
+	for (unsigned i = 0; i < Modules.size(); ++i) {
+		if (!Errors[i].empty())
+			OP<<"== Warning: failed to materialize "<<Modules[i].second
+				<<": "<<Errors[i]<<"\n";
+	}
+}
+
 bool CallGraphPass::doInitialization(Module *M) {
 
 	OP<<"#"<<MIdx<<" Initializing: "<<M->getName()<<"\n";
@@ -160,6 +211,7 @@ bool CallGraphPass::doInitialization(Module *M) {
 	IntPtrTy[M] = DLMap[M]->getIntPtrType(M->getContext());
 
 	set<User *>CastSet;
+	bool HasSummary = Ctx->ModuleSummaryRefs.count(M);
 
 	//
 	// Iterate and process globals
@@ -185,15 +237,9 @@ bool CallGraphPass::doInitialization(Module *M) {
 
 		// Collect address-taken functions.
 		// NOTE: declaration functions can also have address taken 
-		if (F.hasAddressTaken()) {
-			Ctx->AddressTakenFuncs.insert(&F);
-			size_t FuncHash = funcHash(&F, false);
-			Ctx->sigFuncsMap[FuncHash].insert(&F);
-			StringRef FName = F.getName();
-      if (FName.startswith("__x64") ||
-          FName.startswith("__ia32")) {
-        OutScopeFuncs.insert(&F);
-      }
+		// Modules with a summary have been handled by the prepass
+		if (!HasSummary && F.hasAddressTaken()) {
+			collectAddressTakenFunc(&F);
 		}
 
 		// The following only considers actual functions with body
@@ -201,47 +247,15 @@ bool CallGraphPass::doInitialization(Module *M) {
 			continue;
 		}
 
-		collectAliasStructPtr(&F);
 		typeConfineInFunction(&F);
 		typePropInFunction(&F);
-
-		// Collect global function definitions.
-		if (F.hasExternalLinkage()) {
-			Ctx->GlobalFuncMap[F.getGUID()] = &F;
-		}
+		evictFunctionCaches();
 	}
 
 	// Do something at the end of last module
 	if (Ctx->Modules.size() == MIdx) {
-
-		// Map the declaration functions to actual ones
-		// NOTE: to delete an item, must iterate by reference
-		for (auto &SF : Ctx->sigFuncsMap) {
-			for (auto F : SF.second) {
-				if (!F)
-					continue;
-				if (F->isDeclaration()) {
-					SF.second.erase(F);
-					if (Function *AF = Ctx->GlobalFuncMap[F->getGUID()]) {
-						SF.second.insert(AF);
-					}
-				}
-			}
-		}
-
-		for (auto &TF : typeIdxFuncsMap) {
-			for (auto &IF : TF.second) {
-				for (auto F : IF.second) {
-					if (F->isDeclaration()) {
-						IF.second.erase(F);
-						if (Function *AF = Ctx->GlobalFuncMap[F->getGUID()]) {
-							IF.second.insert(AF);
-						}
-					}
-				}
-			}
-		}
-
+		// Phase-1 maps are complete and will only be read from now on
+		freezeTypeTables();
 		MIdx = 0;
 	}
 
@@ -250,32 +264,8 @@ bool CallGraphPass::doInitialization(Module *M) {
 
 bool CallGraphPass::doFinalization(Module *M) {
 
-	++ MIdx;
-	if (Ctx->Modules.size() == MIdx) {
-		// Finally map declaration functions to actual functions
-		OP<<"Mapping declaration functions to actual ones...\n";
-		Ctx->NumIndirectCallTargets = 0;
-		for (auto CI : CallSet) {
-			FuncSet FS;
-			for (auto F : Ctx->Callees[CI]) {
-				if (F->isDeclaration()) {
-					F = Ctx->GlobalFuncMap[F->getGUID()];
-					if (F) {
-						FS.insert(F);
-					}
-				}
-				else
-					FS.insert(F);
-			}
-			Ctx->Callees[CI] = FS;
-
-			if (CI->isIndirectCall()) {
-				Ctx->NumIndirectCallTargets += FS.size();
-				//printTargets(Ctx->Callees[CI], CI);
-			}
-		}
-
-	}
+	// Declarations are resolved to their definitions before the
+	// analysis, so there is nothing to remap here
 	return false;
 }
 
@@ -312,8 +302,19 @@ bool CallGraphPass::doModulePass(Module *M) {
 			continue;
 
 		doMLTA(F);
+		evictFunctionCaches();
 	}
 
+#ifdef MAP_CALLER_TO_CALLEE
+	// All callees are resolved after the last module
+	if (MIdx == Ctx->Modules.size())
+		buildCallGraphIndex();
+#endif
+
 	return false;
 }
 
+// Index the resolved call graph by the IDs of the callsite table
+void CallGraphPass::buildCallGraphIndex() {
+	Ctx->CG.build(Ctx->CallSites, Ctx->TargetSets, Ctx->IDFuncs.size());
+}
@@ -17,15 +17,15 @@ class CallGraphPass :
 		// Index of the module
 		int MIdx;
 
-		set<CallInst *>CallSet;
-		set<CallInst *>ICallSet;
-		set<CallInst *>MatchedICallSet;
-
 
 		//
 		// Methods
 		//
 		void doMLTA(Function *F);
+		void collectAddressTakenFunc(Function *F);
+		void collectSummaryGlobalFacts();
+		void materializeModules();
+		void buildCallGraphIndex();
 
 
 	public:
@@ -35,7 +35,14 @@ class CallGraphPass :
 			: IterativeModulePass(Ctx_, "CallGraph"),
 			MLTA(Ctx_) {
 
-				LoadElementsStructNameMap(Ctx->Modules);
+				resolveSymbols();
+				// Global facts of modules with ThinLTO summaries come
+				// from the summaries, except for casted callees
+				if (!Ctx->ModuleSummaryRefs.empty()) {
+					materializeModules();
+					collectSummaryGlobalFacts();
+				}
+				buildStructIdentityIndex(Ctx->Modules);
 				MIdx = 0;
 			}
 
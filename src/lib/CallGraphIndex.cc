@@ -0,0 +1,60 @@
+//===-- CallGraphIndex.cc - CSR call graph ----------------------===//
+//
+// Builds the forward and reverse adjacency arrays of the resolved
+// call graph.
+//
+//===-----------------------------------------------------------===//
+
+#include "CallGraphIndex.h"
+
+// Fill a CSR row array by counting: Begin[Row + 1] first counts the
+// IDs of Row, the prefix sum turns the counts into offsets, and the IDs are
+// then placed at the running offsets.
+template <typename ForEachEdgeT>
+static void buildRows(unsigned NumRows, vector<unsigned> &Begin,
+		vector<unsigned> &IDs, ForEachEdgeT ForEachEdge) {
+
+	Begin.assign(NumRows + 1, 0);
+	ForEachEdge([&](unsigned Row, unsigned) { ++Begin[Row + 1]; });
+	for (unsigned i = 0; i < NumRows; ++i)
+		Begin[i + 1] += Begin[i];
+
+	IDs.resize(Begin[NumRows]);
+	vector<unsigned> Next(Begin.begin(), Begin.end() - 1);
+	ForEachEdge([&](unsigned Row, unsigned ID) { IDs[Next[Row]++] = ID; });
+}
+
+void CallGraphIndex::build(const CallSiteTable &Sites,
+		const TargetSetStore &Sets, unsigned NumFuncs) {
+
+	unsigned NumSites = Sites.size();
+
+	buildRows(NumSites, CalleeBegin, CalleeFuncs,
+			[&](auto Edge) {
+			for (unsigned Site = 0; Site < NumSites; ++Site)
+				Sites.forEachCallee(Site, Sets, [&](uint32_t F) {
+					Edge(Site, F);
+				});
+			});
+
+	buildRows(NumFuncs, FuncSitesBegin, FuncSites,
+			[&](auto Edge) {
+			for (unsigned Site = 0; Site < NumSites; ++Site)
+				Edge(Sites.getCaller(Site), Site);
+			});
+
+	buildRows(NumFuncs, CallerBegin, CallerSites,
+			[&](auto Edge) {
+			for (unsigned Site = 0; Site < NumSites; ++Site)
+				for (unsigned F : callees(Site))
+					Edge(F, Site);
+			});
+}
+
+size_t CallGraphIndex::getMemorySize() const {
+
+	return (CalleeBegin.capacity() + CalleeFuncs.capacity()
+			+ FuncSitesBegin.capacity() + FuncSites.capacity()
+			+ CallerBegin.capacity() + CallerSites.capacity())
+		* sizeof(unsigned);
+}
@@ -0,0 +1,61 @@
+#ifndef _CALL_GRAPH_INDEX_H
+#define _CALL_GRAPH_INDEX_H
+
+#include <llvm/ADT/ArrayRef.h>
+#include <vector>
+
+#include "CallSiteTable.h"
+#include "TargetSetStore.h"
+
+using namespace std;
+using namespace llvm;
+
+//
+// Read-only call graph in compressed sparse row form, built once
+// after the callees are resolved. Callsites are the IDs of the
+// callsite table and functions are the dense function IDs of the
+// analysis. Each direction is one offset array and one array of
+// IDs:
+//   callees(Site)    - function IDs a callsite may call
+//   callSitesIn(F)   - callsites in the body of function F
+//   callersOf(F)     - callsites that may call function F
+//
+class CallGraphIndex {
+
+	public:
+		// Function IDs are below NumFuncs
+		void build(const CallSiteTable &Sites, const TargetSetStore &Sets,
+				unsigned NumFuncs);
+
+		ArrayRef<unsigned> callees(unsigned Site) const {
+			return rowOf(CalleeBegin, CalleeFuncs, Site);
+		}
+		ArrayRef<unsigned> callSitesIn(unsigned F) const {
+			return rowOf(FuncSitesBegin, FuncSites, F);
+		}
+		ArrayRef<unsigned> callersOf(unsigned F) const {
+			return rowOf(CallerBegin, CallerSites, F);
+		}
+
+		size_t getMemorySize() const;
+
+	private:
+		vector<unsigned> CalleeBegin;
+		vector<unsigned> CalleeFuncs;
+
+		vector<unsigned> FuncSitesBegin;
+		vector<unsigned> FuncSites;
+
+		vector<unsigned> CallerBegin;
+		vector<unsigned> CallerSites;
+
+		static ArrayRef<unsigned> rowOf(const vector<unsigned> &Begin,
+				const vector<unsigned> &IDs, unsigned Row) {
+			if (Row + 1 >= Begin.size())
+				return ArrayRef<unsigned>();
+			return makeArrayRef(IDs).slice(Begin[Row],
+					Begin[Row + 1] - Begin[Row]);
+		}
+};
+
+#endif
@@ -0,0 +1,40 @@
+//===-- CallSiteTable.cc - Dense table of callsites -------------===//
+//
+// Assigns callsite IDs and keeps the per-callsite columns.
+//
+//===-----------------------------------------------------------===//
+
+#include "CallSiteTable.h"
+
+unsigned CallSiteTable::add(CallInst *CI, uint8_t Kind, unsigned SigID,
+		unsigned CallerID) {
+
+	auto Ins = IDs.insert(make_pair(CI, Insts.size()));
+	if (!Ins.second)
+		return Ins.first->second;
+
+	Insts.push_back(CI);
+	Kinds.push_back(Kind);
+	SigIDs.push_back(SigID);
+	Callers.push_back(CallerID);
+	// The empty set, or no callee
+	Targets.push_back(Kind & CS_INDIRECT ? 0 : NO_CALLEE);
+	return Ins.first->second;
+}
+
+int CallSiteTable::lookup(CallInst *CI) const {
+
+	auto it = IDs.find(CI);
+	if (it == IDs.end())
+		return -1;
+	return it->second;
+}
+
+size_t CallSiteTable::getMemorySize() const {
+
+	return Insts.capacity() * sizeof(CallInst *)
+		+ Kinds.capacity() * sizeof(uint8_t)
+		+ (SigIDs.capacity() + Callers.capacity()
+				+ Targets.capacity()) * sizeof(unsigned)
+		+ IDs.getMemorySize();
+}
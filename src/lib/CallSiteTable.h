@@ -0,0 +1,82 @@
+#ifndef _CALL_SITE_TABLE_H
+#define _CALL_SITE_TABLE_H
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/IR/Instructions.h>
+#include <vector>
+#include <cstdint>
+
+#include "TargetSetStore.h"
+
+using namespace std;
+using namespace llvm;
+
+// Kinds of a callsite, as bits
+enum CallSiteKind : uint8_t {
+	CS_DIRECT = 1 << 0,
+	CS_INDIRECT = 1 << 1,
+	// An indirect call with at least one target
+	CS_MATCHED = 1 << 2,
+	// An indirect call left with all targets of its signature
+	CS_FALLBACK = 1 << 3,
+};
+
+// Callee of a direct call without a known function, like inline asm
+#define NO_CALLEE (~0U)
+
+//
+// Every call instruction of the analysis, with a dense ID in the
+// order the calls are resolved. The attributes are kept in columns
+// indexed by the ID, so passes over the calls are linear scans.
+//
+class CallSiteTable {
+
+	public:
+		// Add a callsite; a callsite already in the table keeps its ID
+		unsigned add(CallInst *CI, uint8_t Kind, unsigned SigID,
+				unsigned CallerID);
+
+		// The ID of a callsite, or -1 if it is not in the table
+		int lookup(CallInst *CI) const;
+
+		unsigned size() const { return Insts.size(); }
+
+		CallInst *getInst(unsigned ID) const { return Insts[ID]; }
+		uint8_t getKind(unsigned ID) const { return Kinds[ID]; }
+		bool is(unsigned ID, uint8_t Kind) const { return Kinds[ID] & Kind; }
+		void addKind(unsigned ID, uint8_t Kind) { Kinds[ID] |= Kind; }
+		unsigned getSigID(unsigned ID) const { return SigIDs[ID]; }
+		// Function ID of the function containing the call
+		unsigned getCaller(unsigned ID) const { return Callers[ID]; }
+
+		// Only indirect calls have a materialized target set. A direct
+		// call keeps the function ID of the function it calls (its
+		// definition if one is loaded), or NO_CALLEE; both share one
+		// column.
+		unsigned getTargetSet(unsigned ID) const { return Targets[ID]; }
+		void setTargetSet(unsigned ID, unsigned SetID) { Targets[ID] = SetID; }
+		unsigned getCallee(unsigned ID) const { return Targets[ID]; }
+		void setCallee(unsigned ID, unsigned FuncID) { Targets[ID] = FuncID; }
+
+		// Visit the function IDs of the potential callees of a call
+		template <typename FnT>
+		void forEachCallee(unsigned ID, const TargetSetStore &Sets,
+				FnT Fn) const {
+			if (is(ID, CS_INDIRECT))
+				Sets.get(Targets[ID]).forEach(Fn);
+			else if (Targets[ID] != NO_CALLEE)
+				Fn(Targets[ID]);
+		}
+
+		size_t getMemorySize() const;
+
+	private:
+		vector<CallInst *> Insts;
+		vector<uint8_t> Kinds;
+		vector<unsigned> SigIDs;
+		vector<unsigned> Callers;
+		vector<unsigned> Targets;
+		DenseMap<CallInst *, unsigned> IDs;
+};
+
+#endif
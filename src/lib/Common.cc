@@ -2,14 +2,18 @@
 #include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Operator.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/BinaryFormat/Dwarf.h>
 #include <fstream>
 #include <regex>
 #include "Common.h"
 #include "Config.h"
 
 
-// Map from struct elements to its name
-static map<string, set<StringRef>>elementsStructNameMap;
+// Memoized type hashes. Types are uniqued within an LLVM context, so
+// each context has its own table.
+static DenseMap<LLVMContext *, DenseMap<Type *, Hash128>>typeHashCache;
 
 bool trimPathSlash(string &path, int slash) {
 	while (slash > 0) {
@@ -319,21 +323,6 @@ Argument *getParamByArgNo(Function *F, int8_t ArgNo) {
   return ai;
 }
 
-void LoadElementsStructNameMap(
-		vector<pair<Module*, StringRef>> &Modules) {
-
-	for (auto M : Modules) {
-		for (auto STy : M.first->getIdentifiedStructTypes()) {
-			assert(STy->hasName());
-			if (STy->isOpaque())
-				continue;
-
-			string strSTy = structTyStr(STy);
-			elementsStructNameMap[strSTy].insert(STy->getName());
-		}
-	}
-}
-
 void cleanString(string &str) {
 	// process string
 	// remove c++ class type added by compiler
@@ -367,57 +356,605 @@ string funcTypeString(FunctionType *FTy) {
 	return output;
 }
 
-size_t funcHash(Function *F, bool withName) {
+//
+// Structural type hashing. A type identity is a stream of tokens
+// produced by walking the type structure: type IDs, bit widths,
+// element counts and struct names. Named structs are identified by
+// their names, and unnamed identified structs by their bodies. The
+// walk never enters named structs, and refers back to an unnamed
+// struct that is being walked, so recursive structs cannot form
+// cycles.
+//
+// The token streams are hashed with a seeded 128-bit hash that only
+// depends on the seed and the tokens, so the hashes are stable across
+// processes and can be used as persistent keys. The analysis keys on
+// the low 64 bits.
+//
+
+// Tags that do not overlap with Type::TypeID
+#define HASH_TAG_STRUCT_NAME     0x100
+#define HASH_TAG_UNNAMED_STRUCT  0x101
+#define HASH_TAG_THIS_PARAM      0x102
+#define HASH_TAG_ARRAY           0x103
+#define HASH_TAG_BACKREF         0x104
+#define HASH_TAG_FIELD_IDX       0x105
+#define HASH_TAG_SOURCE          0x106
+
+// Key that separates the two lanes of the 128-bit hash
+#define HASH_HI_LANE_KEY 0xc3a5c85c97cb3127ULL
+
+// Mixing function of CityHash (Hash128to64)
+static inline uint64_t hashCombine(uint64_t H, uint64_t V) {
+	const uint64_t Mul = 0x9ddfea08eb382d69ULL;
+	uint64_t A = (V ^ H) * Mul;
+	A ^= (A >> 47);
+	uint64_t B = (H ^ A) * Mul;
+	B ^= (B >> 47);
+	return B * Mul;
+}
 
-	hash<string> str_hash;
-	string output;
+// Hash tokens into two lanes that start from different states
+class HashSink {
+
+	public:
+		HashSink(uint64_t Seed) {
+			H.Lo = hashCombine(Seed, 0);
+			H.Hi = hashCombine(Seed, HASH_HI_LANE_KEY);
+		}
+		HashSink(const Hash128 &Init) : H(Init) {}
+
+		void add(uint64_t V) {
+			H.Lo = hashCombine(H.Lo, V);
+			H.Hi = hashCombine(H.Hi, V ^ HASH_HI_LANE_KEY);
+		}
+
+		// Names are hashed in 8-byte little-endian words
+		void addName(StringRef Name) {
+			add(Name.size());
+			for (size_t i = 0; i < Name.size(); i += 8) {
+				uint64_t W = 0;
+				for (size_t j = 0; j < 8 && i + j < Name.size(); ++j)
+					W |= (uint64_t)(uint8_t)Name[i + j] << (8 * j);
+				add(W);
+			}
+		}
+
+		Hash128 get() const { return H; }
+
+	private:
+		Hash128 H;
+};
+
+// Print tokens as the canonical string of a type identity; used by
+// the hash audit
+class StringSink {
+
+	public:
+		void add(uint64_t V) {
+			Str += to_string(V);
+			Str += ',';
+		}
+
+		void addName(StringRef Name) {
+			Str += '"';
+			Str += Name.str();
+			Str += "\",";
+		}
+
+		string &get() { return Str; }
+
+	private:
+		string Str;
+};
+
+// Whether the name is printed without quotes
+static bool isPlainName(StringRef Name) {
+	if (Name.empty() || isdigit(Name[0]))
+		return false;
+	for (char C : Name) {
+		if (!isalnum(C) && C != '-' && C != '$' && C != '.' && C != '_')
+			return false;
+	}
+	return true;
+}
+
+typedef SmallVector<StructType *, 4> StructStack;
+
+template <class SinkT>
+static void walkType(Type *Ty, bool &StripThis, SinkT &S,
+		StructStack &Stack);
+
+// Walk a function type. StripThis mirrors the string cleanup that
+// removes the C++ "this" parameter: the first parameter list, in
+// printed order, that starts with a "%class." type decides, and its
+// first parameter is dropped if it is "%class.<word>*".
+template <class SinkT>
+static void walkFuncType(FunctionType *FTy, bool &StripThis, SinkT &S,
+		StructStack &Stack) {
+
+	S.add(Type::FunctionTyID);
+	S.add(FTy->isVarArg());
+	walkType(FTy->getReturnType(), StripThis, S, Stack);
+
+	unsigned I = 0, N = FTy->getNumParams();
+	SmallVector<unsigned, 4> OuterAS;
+	if (StripThis && N > 0) {
+		// Peel the pointers of the first parameter
+		Type *BTy = FTy->getParamType(0);
+		while (PointerType *PTy = dyn_cast<PointerType>(BTy)) {
+			if (PTy->isOpaque())
+				break;
+			OuterAS.push_back(PTy->getAddressSpace());
+			BTy = PTy->getPointerElementType();
+		}
+
+		StructType *STy = dyn_cast<StructType>(BTy);
+		if (STy && !STy->isLiteral() && STy->hasName()
+				&& STy->getName().startswith("class.")
+				&& isPlainName(STy->getName())) {
+			StripThis = false;
+
+			StringRef Word = STy->getName().drop_front(6);
+			bool IsWord = !Word.empty() && all_of(Word, [](char C) {
+					return isalnum(C) || C == '_';
+					});
+			// The pointer right above the class must be "*"
+			if (IsWord && !OuterAS.empty() && OuterAS.back() == 0) {
+				OuterAS.pop_back();
+				I = 1;
+			}
+		}
+	}
+
+	// Outer pointers that remain of a stripped parameter
+	if (I == 1 && !OuterAS.empty()) {
+		S.add(HASH_TAG_THIS_PARAM);
+		S.add(OuterAS.size());
+		for (unsigned AS : OuterAS)
+			S.add(AS);
+	}
+
+	S.add(N - I);
+	for (; I < N; ++I)
+		walkType(FTy->getParamType(I), StripThis, S, Stack);
+}
+
+template <class SinkT>
+static void walkType(Type *Ty, bool &StripThis, SinkT &S,
+		StructStack &Stack) {
+
+	switch (Ty->getTypeID()) {
+		case Type::IntegerTyID:
+			S.add(Ty->getTypeID());
+			S.add(Ty->getIntegerBitWidth());
+			return;
+
+		case Type::PointerTyID: {
+			PointerType *PTy = cast<PointerType>(Ty);
+			S.add(Ty->getTypeID());
+			S.add(PTy->getAddressSpace());
+			S.add(PTy->isOpaque());
+			if (!PTy->isOpaque())
+				walkType(PTy->getPointerElementType(), StripThis, S, Stack);
+			return;
+		}
+
+		case Type::ArrayTyID:
+			S.add(Ty->getTypeID());
+			S.add(Ty->getArrayNumElements());
+			walkType(Ty->getArrayElementType(), StripThis, S, Stack);
+			return;
+
+		case Type::FixedVectorTyID:
+		case Type::ScalableVectorTyID: {
+			VectorType *VTy = cast<VectorType>(Ty);
+			S.add(Ty->getTypeID());
+			S.add(VTy->getElementCount().getKnownMinValue());
+			walkType(VTy->getElementType(), StripThis, S, Stack);
+			return;
+		}
+
+		case Type::StructTyID: {
+			StructType *STy = cast<StructType>(Ty);
+			if (!STy->isLiteral()) {
+				if (STy->hasName()) {
+					S.add(HASH_TAG_STRUCT_NAME);
+					S.addName(STy->getName());
+					return;
+				}
+				auto it = find(Stack.begin(), Stack.end(), STy);
+				if (it != Stack.end()) {
+					S.add(HASH_TAG_BACKREF);
+					S.add(Stack.end() - it);
+					return;
+				}
+				S.add(HASH_TAG_UNNAMED_STRUCT);
+			}
+			else
+				S.add(Ty->getTypeID());
+
+			Stack.push_back(STy);
+			S.add(STy->isPacked());
+			S.add(STy->getNumElements());
+			for (Type *ETy : STy->elements())
+				walkType(ETy, StripThis, S, Stack);
+			Stack.pop_back();
+			return;
+		}
+
+		case Type::FunctionTyID:
+			walkFuncType(cast<FunctionType>(Ty), StripThis, S, Stack);
+			return;
+
+		default:
+			// Void, floating-point and other primitive types
+			S.add(Ty->getTypeID());
+			return;
+	}
+}
+
+//
+// Struct identity index. A struct without a name (mostly a literal
+// struct of a global initializer) is identified by the named structs
+// it stands for, found in this order:
+//   1. the debug info of the global variables it initializes;
+//   2. named structs with exactly the same elements;
+//   3. named structs with the same kinds of elements.
+// The index is built in parallel, one task per module.
+//
+struct ModuleStructNames {
+	vector<pair<StructType *, string>>DINames;
+	vector<pair<uint64_t, StringRef>>BodyNames;
+	vector<pair<string, StringRef>>KindNames;
+};
+
+static DenseMap<StructType *, set<string>>diStructNames;
+static DenseMap<uint64_t, set<string>>bodyStructNames;
+static map<string, set<string>>kindStructNames;
+// Resolved lookups; NULL if a struct has no identity
+static DenseMap<StructType *, const set<string> *>structNamesCache;
+
+// Fingerprint of the elements of a struct
+static uint64_t structBodyHash(StructType *STy) {
+
+	HashSink S(HashSeed);
+	bool StripThis = false;
+	StructStack Stack;
+	Stack.push_back(STy);
+	S.add(STy->isPacked());
+	S.add(STy->getNumElements());
+	for (Type *ETy : STy->elements())
+		walkType(ETy, StripThis, S, Stack);
+
+	return S.get().Lo;
+}
+
+// Skip typedefs, qualifiers and members
+static DIType *stripDIType(DIType *T) {
+
+	while (DIDerivedType *DT = dyn_cast_or_null<DIDerivedType>(T)) {
+		switch (DT->getTag()) {
+			case dwarf::DW_TAG_typedef:
+			case dwarf::DW_TAG_const_type:
+			case dwarf::DW_TAG_volatile_type:
+			case dwarf::DW_TAG_restrict_type:
+			case dwarf::DW_TAG_atomic_type:
+			case dwarf::DW_TAG_member:
+				T = DT->getBaseType();
+				break;
+			default:
+				return T;
+		}
+	}
+	return T;
+}
+
+// Walk the type of an initializer along with its debug-info type, and
+// name the structs without a name. Struct elements are matched with
+// the members at the same offsets.
+static void collectDIStructNames(Type *Ty, DIType *T,
+		const DataLayout &DL, set<pair<Type *, DIType *>> &Visited,
+		vector<pair<StructType *, string>> &Names) {
+
+	DICompositeType *CT = dyn_cast_or_null<DICompositeType>(stripDIType(T));
+	if (!CT)
+		return;
+	if (!Visited.insert(make_pair(Ty, CT)).second)
+		return;
+
+	if (ArrayType *ATy = dyn_cast<ArrayType>(Ty)) {
+		if (CT->getTag() != dwarf::DW_TAG_array_type)
+			return;
+		// A multi-dimensional array has a single debug-info type
+		Type *ETy = ATy->getElementType();
+		collectDIStructNames(ETy, ETy->isArrayTy() ? CT : CT->getBaseType(),
+				DL, Visited, Names);
+		return;
+	}
+
+	StructType *STy = dyn_cast<StructType>(Ty);
+	if (!STy || STy->isOpaque())
+		return;
+
+	const char *Prefix = NULL;
+	switch (CT->getTag()) {
+		case dwarf::DW_TAG_structure_type:
+			Prefix = "struct.";
+			break;
+		case dwarf::DW_TAG_union_type:
+			Prefix = "union.";
+			break;
+		case dwarf::DW_TAG_class_type:
+			Prefix = "class.";
+			break;
+		default:
+			return;
+	}
+
+	if (!STy->hasName() && !CT->getName().empty()) {
+		string Name = Prefix + CT->getName().str();
+		// Only names that the module actually uses
+		if (StructType::getTypeByName(STy->getContext(), Name))
+			Names.push_back(make_pair(STy, Name));
+	}
+
+	const StructLayout *SL = DL.getStructLayout(STy);
+	for (unsigned i = 0; i < STy->getNumElements(); ++i) {
+		uint64_t Off = SL->getElementOffsetInBits(i);
+		for (DINode *N : CT->getElements()) {
+			DIDerivedType *Member = dyn_cast_or_null<DIDerivedType>(N);
+			if (!Member || Member->getTag() != dwarf::DW_TAG_member
+					|| Member->getOffsetInBits() != Off)
+				continue;
+			collectDIStructNames(STy->getElementType(i), Member->getBaseType(),
+					DL, Visited, Names);
+		}
+	}
+}
+
+static void collectModuleStructNames(Module *M, ModuleStructNames &MN) {
+
+	for (auto STy : M->getIdentifiedStructTypes()) {
+		assert(STy->hasName());
+		if (STy->isOpaque())
+			continue;
+
+		MN.BodyNames.push_back(make_pair(structBodyHash(STy), STy->getName()));
+		MN.KindNames.push_back(make_pair(structTyStr(STy), STy->getName()));
+	}
+
+	const DataLayout &DL = M->getDataLayout();
+	set<pair<Type *, DIType *>>Visited;
+	SmallVector<DIGlobalVariableExpression *, 1> GVEs;
+	for (GlobalVariable &GV : M->globals()) {
+		if (!GV.hasInitializer())
+			continue;
+		GVEs.clear();
+		GV.getDebugInfo(GVEs);
+		for (auto GVE : GVEs)
+			collectDIStructNames(GV.getInitializer()->getType(),
+					GVE->getVariable()->getType(), DL, Visited, MN.DINames);
+	}
+}
+
+void buildStructIdentityIndex(
+		vector<pair<Module*, StringRef>> &Modules) {
+
+	vector<ModuleStructNames>ModuleNames(Modules.size());
+
+	ThreadPool Pool;
+	for (unsigned i = 0; i < Modules.size(); ++i) {
+		Module *M = Modules[i].first;
+		ModuleStructNames *MN = &ModuleNames[i];
+		Pool.async([M, MN]() {
+			collectModuleStructNames(M, *MN);
+		});
+	}
+	Pool.wait();
+
+	for (auto &MN : ModuleNames) {
+		for (auto &N : MN.DINames)
+			diStructNames[N.first].insert(N.second);
+		for (auto &N : MN.BodyNames)
+			bodyStructNames[N.first].insert(N.second.str());
+		for (auto &N : MN.KindNames)
+			kindStructNames[N.first].insert(N.second.str());
+	}
+	structNamesCache.clear();
+}
+
+// Get the names of the named structs that STy, a struct without a
+// name, stands for; NULL if there are none
+static const set<string> *getStructIdentityNames(StructType *STy) {
+
+	auto it = structNamesCache.find(STy);
+	if (it != structNamesCache.end())
+		return it->second;
+
+	const set<string> *Names = NULL;
+	auto DI = diStructNames.find(STy);
+	if (DI != diStructNames.end())
+		Names = &DI->second;
+	if (!Names && !STy->isOpaque()) {
+		auto B = bodyStructNames.find(structBodyHash(STy));
+		if (B != bodyStructNames.end())
+			Names = &B->second;
+	}
+	if (!Names) {
+		auto K = kindStructNames.find(structTyStr(STy));
+		if (K != kindStructNames.end())
+			Names = &K->second;
+	}
+
+	structNamesCache[STy] = Names;
+	return Names;
+}
+
+// Walk the identity of a type as used by the type tables. Structs
+// are identified by their names; a struct without a name takes the
+// first name in the struct identity index.
+template <class SinkT>
+static void walkTypeIdentity(Type *Ty, SinkT &S) {
+
+	if (StructType *STy = dyn_cast<StructType>(Ty)) {
+		// FIXME: A few cases may not even have a name
+		StringRef Name;
+		if (STy->hasName()) {
+			Name = STy->getName();
+		}
+		else if (const set<string> *Names = getStructIdentityNames(STy)) {
+			Name = *Names->begin();
+		}
+		S.add(HASH_TAG_STRUCT_NAME);
+		S.addName(Name);
+		return;
+	}
+
+	bool StripThis = false;
+	StructStack Stack;
+#ifdef SOUND_MODE
+	if (isa<ArrayType>(Ty)) {
+		// Compiler sometimes fails recoginize size of array (compiler
+		// bug?), so top-level arrays are kept apart
+		S.add(HASH_TAG_ARRAY);
+	}
+#endif
+	walkType(Ty, StripThis, S, Stack);
+}
+
+// Walk a function signature, without the C++ "this" parameter
+template <class SinkT>
+static void walkFuncSignature(FunctionType *FTy, SinkT &S) {
+	bool StripThis = true;
+	StructStack Stack;
+	walkFuncType(FTy, StripThis, S, Stack);
+}
+
+//
+// Hash audit: record the canonical string of every hash, and report
+// the hashes that are shared by different identities
+//
+struct HashAuditEntry {
+	uint64_t Hi;
+	string Example;
+};
+// Low 64 bits -> canonical string -> entry
+static map<uint64_t, map<string, HashAuditEntry>>hashAuditMap;
+
+template <class WalkT>
+static void auditHash(const Hash128 &H, WalkT Walk, string Example) {
+
+	StringSink SS;
+	Walk(SS);
+	auto &Entries = hashAuditMap[H.Lo];
+	if (Entries.find(SS.get()) == Entries.end())
+		Entries[SS.get()] = HashAuditEntry{H.Hi, Example};
+}
+
+template <class T>
+static string printToString(T *X) {
+	string Str;
+	raw_string_ostream OS(Str);
+	X->print(OS);
+	return OS.str();
+}
+
+string hash128Str(const Hash128 &H) {
+	char Buf[40];
+	snprintf(Buf, sizeof(Buf), "%016llx%016llx",
+			(unsigned long long)H.Hi, (unsigned long long)H.Lo);
+	return Buf;
+}
+
+void reportHashAudit() {
+
+	size_t NumIdentities = 0, Num64 = 0, Num128 = 0;
+	for (auto &HE : hashAuditMap) {
+		NumIdentities += HE.second.size();
+		if (HE.second.size() < 2)
+			continue;
+
+		// Different identities that share the low 64 bits: they are
+		// merged by the analysis
+		++Num64;
+		map<uint64_t, unsigned>HiCount;
+		for (auto &E : HE.second)
+			++HiCount[E.second.Hi];
+		for (auto &HC : HiCount) {
+			if (HC.second > 1)
+				++Num128;
+		}
+
+		OP<<"== Hash collision on "<<format_hex(HE.first, 18)<<":\n";
+		for (auto &E : HE.second) {
+			Hash128 H;
+			H.Lo = HE.first;
+			H.Hi = E.second.Hi;
+			OP<<"\t"<<hash128Str(H)<<"  "<<E.second.Example<<"\n";
+		}
+	}
+
+	OP<<"############## Hash audit ##############\n";
+	OP<<"# Number of hashed identities: \t\t\t"<<NumIdentities<<"\n";
+	OP<<"# Number of 64-bit collisions: \t\t\t"<<Num64<<"\n";
+	OP<<"# Number of 128-bit collisions: \t\t"<<Num128<<"\n";
+}
+
+static uint64_t structNameHash(StringRef Name) {
+	HashSink S(HashSeed);
+	S.add(HASH_TAG_STRUCT_NAME);
+	S.addName(Name);
+	if (HashAudit)
+		auditHash(S.get(), [&](StringSink &SS) {
+				SS.add(HASH_TAG_STRUCT_NAME);
+				SS.addName(Name);
+				}, "%" + Name.str());
+	return S.get().Lo;
+}
+
+Hash128 funcTypeHash128(FunctionType *FTy) {
+
+	HashSink S(HashSeed);
+	walkFuncSignature(FTy, S);
+	if (HashAudit)
+		auditHash(S.get(), [&](StringSink &SS) {
+				walkFuncSignature(FTy, SS);
+				}, printToString(FTy));
+	return S.get();
+}
+
+size_t funcTypeHash(FunctionType *FTy) {
+	return funcTypeHash128(FTy).Lo;
+}
+
+size_t funcHash(Function *F, bool withName) {
 
 #ifdef HASH_SOURCE_INFO
 	DISubprogram *SP = F->getSubprogram();
 
 	if (SP) {
-		output = SP->getFilename();
-		output = output + to_string(uint_hash(SP->getLine()));
+		HashSink S(HashSeed);
+		S.add(HASH_TAG_SOURCE);
+		S.addName(SP->getFilename());
+		S.add(SP->getLine());
+		return S.get().Lo;
 	}
-	else {
 #endif
-		string sig;
-		raw_string_ostream rso(sig);
-		FunctionType *FTy = F->getFunctionType();
-		FTy->print(rso);
-		output = rso.str();
-		//output = funcTypeString(FTy);
+	Hash128 H = funcTypeHash128(F->getFunctionType());
 
-		if (withName)
-			output += F->getName();
-#ifdef HASH_SOURCE_INFO
+	if (withName) {
+		HashSink S(H);
+		S.addName(F->getName());
+		H = S.get();
 	}
-#endif
-	// process string
-	cleanString(output);
 
-	return str_hash(output);
+	return H.Lo;
 }
 
 size_t callHash(CallInst *CI) {
 
 	CallBase *CB = dyn_cast<CallBase>(CI);
-	//Value *CO = CI->getCalledOperand();
-	//if (CO) {
-	//	Function *CF = dyn_cast<Function>(CO);
-	//	if (CF)
-	//		return funcHash(CF);
-	//}
-	hash<string> str_hash;
-	string sig;
-	raw_string_ostream rso(sig);
-	FunctionType *FTy = CB->getFunctionType();
-	FTy->print(rso);
-	string strip_str = rso.str();
-	//string strip_str = funcTypeString(FTy);
-	cleanString(strip_str);
-
-	return str_hash(strip_str);
+	return funcTypeHash(CB->getFunctionType());
 }
 
 string structTyStr(StructType *STy) {
@@ -430,85 +967,64 @@ string structTyStr(StructType *STy) {
 }
 
 void structTypeHash(StructType *STy, set<size_t> &HSet) {
-  hash<string> str_hash;
-  string sig;
-  string ty_str;
 
-  // TODO: Use more but reliable information
   // FIXME: A few cases may not even have a name
   if (STy->hasName()) {
-    ty_str = STy->getName().str();
-    HSet.insert(str_hash(ty_str));
+    HSet.insert(structNameHash(STy->getName()));
   }
-  else {
-    string sstr = structTyStr(STy);
-    if (elementsStructNameMap.find(sstr)
-        != elementsStructNameMap.end()) {
-      for (auto SStr : elementsStructNameMap[sstr]) {
-        ty_str = SStr.str();
-        HSet.insert(str_hash(ty_str));
-      }
+  else if (const set<string> *Names = getStructIdentityNames(STy)) {
+    for (auto &SStr : *Names) {
+      HSet.insert(structNameHash(SStr));
     }
   }
 }
 
-size_t typeHash(Type *Ty) {
-  hash<string> str_hash;
-  string sig;
-  string ty_str;
-
-  if (StructType *STy = dyn_cast<StructType>(Ty)) {
-    // TODO: Use more but reliable information
-    // FIXME: A few cases may not even have a name
-    if (STy->hasName()) {
-      ty_str = STy->getName().str();
-    }
-    else {
-      string sstr = structTyStr(STy);
-      if (elementsStructNameMap.find(sstr)
-          != elementsStructNameMap.end()) {
-        ty_str = elementsStructNameMap[sstr].begin()->str();
-      }
-    }
-  }
-#ifdef SOUND_MODE
-  else if (ArrayType *ATy = dyn_cast<ArrayType>(Ty)) {
+// Types are uniqued within an LLVM context, so the hash of a type
+// pointer never changes
+Hash128 typeHash128(Type *Ty) {
 
-    // Compiler sometimes fails recoginize size of array (compiler
-    // bug?), so let's just use the element type
+  DenseMap<Type *, Hash128> &Cache = typeHashCache[&Ty->getContext()];
+  auto it = Cache.find(Ty);
+  if (it != Cache.end())
+    return it->second;
 
-    //Ty = ATy->getElementType();
-    raw_string_ostream rso(sig);
-    Ty->print(rso);
-    ty_str = rso.str() + "[array]";
-    string::iterator end_pos = remove(ty_str.begin(), ty_str.end(), ' ');
-    ty_str.erase(end_pos, ty_str.end());
-  }
-#endif
-  else {
-    raw_string_ostream rso(sig);
-    Ty->print(rso);
-    ty_str = rso.str();
-    string::iterator end_pos = remove(ty_str.begin(), ty_str.end(), ' ');
-    ty_str.erase(end_pos, ty_str.end());
-  }
-  return str_hash(ty_str);
+  HashSink S(HashSeed);
+  walkTypeIdentity(Ty, S);
+  if (HashAudit)
+    auditHash(S.get(), [&](StringSink &SS) {
+        walkTypeIdentity(Ty, SS);
+        }, printToString(Ty));
+
+  Cache[Ty] = S.get();
+  return S.get();
+}
+
+size_t typeHash(Type *Ty) {
+  return typeHash128(Ty).Lo;
+}
+
+Hash128 typeIdxHash128(Type *Ty, int Idx) {
+	HashSink S(typeHash128(Ty));
+	S.add(HASH_TAG_FIELD_IDX);
+	S.add((uint32_t)Idx);
+	return S.get();
 }
 
 size_t hashIdxHash(size_t Hs, int Idx) {
-	hash<string> str_hash;
-	return Hs + str_hash(to_string(Idx));
+	return hashCombine(Hs, (uint64_t)(int64_t)Idx);
 }
 
 size_t typeIdxHash(Type *Ty, int Idx) {
-	return hashIdxHash(typeHash(Ty), Idx);
+	return typeIdxHash128(Ty, Idx).Lo;
 }
 
 size_t strIntHash(string str, int i) {
-	hash<string> str_hash;
 	// FIXME: remove pos
 	size_t pos = str.rfind("/");
-	return str_hash(str.substr(0, pos) + to_string(i));
+	HashSink S(HashSeed);
+	S.addName(StringRef(str).substr(0, pos));
+	S.add((uint32_t)i);
+	return S.get().Lo;
 }
 
 int64_t getGEPOffset(const Value *V, const DataLayout *DL) {
@@ -61,6 +61,25 @@ using namespace std;
 
 
 extern cl::opt<unsigned> VerboseLevel;
+extern cl::opt<unsigned long long> HashSeed;
+extern cl::opt<bool> HashAudit;
+extern cl::opt<bool> TypeTableStats;
+
+// A stable 128-bit hash; the analysis keys on the low 64 bits
+struct Hash128 {
+	uint64_t Lo = 0;
+	uint64_t Hi = 0;
+
+	bool operator==(const Hash128 &H) const {
+		return Lo == H.Lo && Hi == H.Hi;
+	}
+	bool operator!=(const Hash128 &H) const {
+		return !(*this == H);
+	}
+	bool operator<(const Hash128 &H) const {
+		return Hi < H.Hi || (Hi == H.Hi && Lo < H.Lo);
+	}
+};
 
 //
 // Common functions
@@ -91,17 +110,23 @@ void getSourceCodeInfo(Value *V, string &file,
 int8_t getArgNoInCall(CallInst *CI, Value *Arg);
 Argument *getParamByArgNo(Function *F, int8_t ArgNo);
 
+Hash128 funcTypeHash128(FunctionType *FTy);
+size_t funcTypeHash(FunctionType *FTy);
 size_t funcHash(Function *F, bool withName = false);
 size_t callHash(CallInst *CI);
 void structTypeHash(StructType *STy, set<size_t> &HSet);
+Hash128 typeHash128(Type *Ty);
 size_t typeHash(Type *Ty);
+Hash128 typeIdxHash128(Type *Ty, int Idx = -1);
 size_t typeIdxHash(Type *Ty, int Idx = -1);
+string hash128Str(const Hash128 &H);
+void reportHashAudit();
 size_t hashIdxHash(size_t Hs, int Idx = -1);
 size_t strIntHash(string str, int i);
 string structTyStr(StructType *STy);
 bool trimPathSlash(string &path, int slash);
 int64_t getGEPOffset(const Value *V, const DataLayout *DL);
-void LoadElementsStructNameMap(
+void buildStructIdentityIndex(
 		vector<pair<Module*, StringRef>> &Modules);
 
 //
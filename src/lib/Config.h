@@ -25,7 +25,6 @@ extern int ENABLE_MLTA;
 #define MAX_TYPE_LAYER 10
 
 #define MAP_CALLER_TO_CALLEE 1
-#define UNROLL_LOOP_ONCE 1
 #define MAP_DECLARATION_FUNCTION
 // #define PRINT_ICALL_TARGET
 // Path to source code
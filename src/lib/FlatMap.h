@@ -0,0 +1,111 @@
+#ifndef _FLAT_MAP_H
+#define _FLAT_MAP_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+
+#include "PerfectHash.h"
+
+using namespace std;
+
+//
+// Growable hash map from 64-bit keys with open addressing (linear
+// probing). The entries are kept in insertion order in one
+// contiguous array, and the probe table only holds 32-bit indexes
+// into it. Lookups never insert; entries are never erased.
+//
+template <typename ValueT>
+class FlatMap {
+
+	public:
+		typedef pair<uint64_t, ValueT> EntryT;
+		typedef typename vector<EntryT>::iterator iterator;
+		typedef typename vector<EntryT>::const_iterator const_iterator;
+
+		const ValueT *lookup(uint64_t Key) const {
+			if (Slots.empty())
+				return NULL;
+			size_t Mask = Slots.size() - 1;
+			for (size_t S = mixHash64(Key) & Mask; ; S = (S + 1) & Mask) {
+				uint32_t I = Slots[S];
+				if (!I)
+					return NULL;
+				if (Entries[I - 1].first == Key)
+					return &Entries[I - 1].second;
+			}
+		}
+
+		ValueT *lookup(uint64_t Key) {
+			return const_cast<ValueT *>(
+					static_cast<const FlatMap *>(this)->lookup(Key));
+		}
+
+		// The value of Key, default-constructed if Key is new
+		ValueT &getOrInsert(uint64_t Key) {
+			// Keep the load factor below 3/4
+			if ((Entries.size() + 1) * 4 > Slots.size() * 3)
+				rehash(Slots.empty() ? 16 : Slots.size() * 2);
+
+			size_t Mask = Slots.size() - 1;
+			size_t S = mixHash64(Key) & Mask;
+			for (; Slots[S]; S = (S + 1) & Mask) {
+				if (Entries[Slots[S] - 1].first == Key)
+					return Entries[Slots[S] - 1].second;
+			}
+			Entries.emplace_back(Key, ValueT());
+			Slots[S] = Entries.size();
+			return Entries.back().second;
+		}
+
+		// Order the entries by key, so that entries with a common
+		// key prefix are adjacent
+		void sortByKey() {
+			std::sort(Entries.begin(), Entries.end(),
+					[](const EntryT &A, const EntryT &B) {
+					return A.first < B.first;
+					});
+			rehash(Slots.size());
+		}
+
+		iterator begin() { return Entries.begin(); }
+		iterator end() { return Entries.end(); }
+		const_iterator begin() const { return Entries.begin(); }
+		const_iterator end() const { return Entries.end(); }
+		const EntryT &operator[](size_t I) const { return Entries[I]; }
+
+		size_t size() const { return Entries.size(); }
+		bool empty() const { return Entries.empty(); }
+
+		// Memory of the table itself, not of what the values own
+		size_t getMemorySize() const {
+			return Slots.capacity() * sizeof(uint32_t)
+				+ Entries.capacity() * sizeof(EntryT);
+		}
+
+		void clear() {
+			Slots.clear();
+			Slots.shrink_to_fit();
+			Entries.clear();
+			Entries.shrink_to_fit();
+		}
+
+	private:
+		// Index + 1 of the entry in a slot, or 0 if the slot is free
+		vector<uint32_t> Slots;
+		vector<EntryT> Entries;
+
+		void rehash(size_t NumSlots) {
+			Slots.assign(NumSlots, 0);
+			size_t Mask = NumSlots - 1;
+			for (uint32_t I = 0; I < Entries.size(); ++I) {
+				size_t S = mixHash64(Entries[I].first) & Mask;
+				while (Slots[S])
+					S = (S + 1) & Mask;
+				Slots[S] = I + 1;
+			}
+		}
+};
+
+#endif
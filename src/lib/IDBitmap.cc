@@ -0,0 +1,335 @@
+//===-- IDBitmap.cc - Compressed bitmaps of IDs ---------------===//
+//
+// Set operations on the containers of IDBitmap.
+//
+//===-----------------------------------------------------------===//
+
+#include <algorithm>
+#include <iterator>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "IDBitmap.h"
+#include "PerfectHash.h"
+
+// Number of 64-bit words of a bitmap container
+#define BITMAP_WORDS 1024
+// Largest cardinality of an array container
+#define ARRAY_MAX_CARD 4096
+
+//
+// Word operations on bitmap containers. They return the number of
+// bits set in the result.
+//
+static uint32_t orWords(uint64_t *A, const uint64_t *B) {
+
+	uint32_t Card = 0;
+#ifdef __AVX2__
+	for (unsigned i = 0; i < BITMAP_WORDS; i += 4) {
+		__m256i VA = _mm256_loadu_si256((const __m256i *)(A + i));
+		__m256i VB = _mm256_loadu_si256((const __m256i *)(B + i));
+		_mm256_storeu_si256((__m256i *)(A + i), _mm256_or_si256(VA, VB));
+	}
+	for (unsigned i = 0; i < BITMAP_WORDS; ++i)
+		Card += __builtin_popcountll(A[i]);
+#else
+	for (unsigned i = 0; i < BITMAP_WORDS; ++i) {
+		A[i] |= B[i];
+		Card += __builtin_popcountll(A[i]);
+	}
+#endif
+	return Card;
+}
+
+static uint32_t andWords(uint64_t *A, const uint64_t *B) {
+
+	uint32_t Card = 0;
+#ifdef __AVX2__
+	for (unsigned i = 0; i < BITMAP_WORDS; i += 4) {
+		__m256i VA = _mm256_loadu_si256((const __m256i *)(A + i));
+		__m256i VB = _mm256_loadu_si256((const __m256i *)(B + i));
+		_mm256_storeu_si256((__m256i *)(A + i), _mm256_and_si256(VA, VB));
+	}
+	for (unsigned i = 0; i < BITMAP_WORDS; ++i)
+		Card += __builtin_popcountll(A[i]);
+#else
+	for (unsigned i = 0; i < BITMAP_WORDS; ++i) {
+		A[i] &= B[i];
+		Card += __builtin_popcountll(A[i]);
+	}
+#endif
+	return Card;
+}
+
+static inline bool testBit(const vector<uint64_t> &Words, uint16_t Low) {
+	return (Words[Low >> 6] >> (Low & 63)) & 1;
+}
+
+void IDBitmap::Container::toBitmap() {
+
+	Words.assign(BITMAP_WORDS, 0);
+	for (uint16_t Low : Array)
+		Words[Low >> 6] |= 1ULL << (Low & 63);
+	Array.clear();
+	Array.shrink_to_fit();
+}
+
+void IDBitmap::Container::toArray() {
+
+	Array.clear();
+	Array.reserve(Card);
+	for (uint32_t w = 0; w < BITMAP_WORDS; ++w) {
+		uint64_t W = Words[w];
+		while (W) {
+			Array.push_back((w << 6) | __builtin_ctzll(W));
+			W &= W - 1;
+		}
+	}
+	Words.clear();
+	Words.shrink_to_fit();
+}
+
+vector<IDBitmap::Container>::iterator
+IDBitmap::findContainer(uint16_t Key) {
+	return lower_bound(Containers.begin(), Containers.end(), Key,
+			[](const Container &C, uint16_t K) { return C.Key < K; });
+}
+
+vector<IDBitmap::Container>::const_iterator
+IDBitmap::findContainer(uint16_t Key) const {
+	return lower_bound(Containers.begin(), Containers.end(), Key,
+			[](const Container &C, uint16_t K) { return C.Key < K; });
+}
+
+bool IDBitmap::insert(uint32_t ID) {
+
+	uint16_t Key = ID >> 16, Low = ID & 0xffff;
+	auto it = findContainer(Key);
+	if (it == Containers.end() || it->Key != Key) {
+		it = Containers.insert(it, Container());
+		it->Key = Key;
+	}
+
+	if (it->isBitmap()) {
+		uint64_t &W = it->Words[Low >> 6];
+		uint64_t Bit = 1ULL << (Low & 63);
+		if (W & Bit)
+			return false;
+		W |= Bit;
+		++it->Card;
+		return true;
+	}
+
+	auto pos = lower_bound(it->Array.begin(), it->Array.end(), Low);
+	if (pos != it->Array.end() && *pos == Low)
+		return false;
+	it->Array.insert(pos, Low);
+	if (++it->Card > ARRAY_MAX_CARD)
+		it->toBitmap();
+	return true;
+}
+
+bool IDBitmap::contains(uint32_t ID) const {
+
+	uint16_t Key = ID >> 16, Low = ID & 0xffff;
+	auto it = findContainer(Key);
+	if (it == Containers.end() || it->Key != Key)
+		return false;
+
+	if (it->isBitmap())
+		return testBit(it->Words, Low);
+	return binary_search(it->Array.begin(), it->Array.end(), Low);
+}
+
+size_t IDBitmap::size() const {
+
+	size_t Card = 0;
+	for (const Container &C : Containers)
+		Card += C.Card;
+	return Card;
+}
+
+void IDBitmap::unionContainer(Container &A, const Container &B) {
+
+	if (A.isBitmap() && B.isBitmap()) {
+		A.Card = orWords(A.Words.data(), B.Words.data());
+		return;
+	}
+
+	if (A.isBitmap()) {
+		for (uint16_t Low : B.Array) {
+			uint64_t &W = A.Words[Low >> 6];
+			uint64_t Bit = 1ULL << (Low & 63);
+			A.Card += !(W & Bit);
+			W |= Bit;
+		}
+		return;
+	}
+
+	if (B.isBitmap()) {
+		vector<uint16_t> Array;
+		Array.swap(A.Array);
+		A.Words = B.Words;
+		A.Card = B.Card;
+		for (uint16_t Low : Array) {
+			uint64_t &W = A.Words[Low >> 6];
+			uint64_t Bit = 1ULL << (Low & 63);
+			A.Card += !(W & Bit);
+			W |= Bit;
+		}
+		return;
+	}
+
+	vector<uint16_t> Merged;
+	Merged.reserve(A.Array.size() + B.Array.size());
+	set_union(A.Array.begin(), A.Array.end(),
+			B.Array.begin(), B.Array.end(), back_inserter(Merged));
+	A.Array.swap(Merged);
+	A.Card = A.Array.size();
+	if (A.Card > ARRAY_MAX_CARD)
+		A.toBitmap();
+}
+
+void IDBitmap::intersectContainer(Container &A, const Container &B) {
+
+	if (A.isBitmap() && B.isBitmap()) {
+		A.Card = andWords(A.Words.data(), B.Words.data());
+		if (A.Card <= ARRAY_MAX_CARD)
+			A.toArray();
+		return;
+	}
+
+	if (A.isBitmap()) {
+		vector<uint16_t> Array;
+		for (uint16_t Low : B.Array) {
+			if (testBit(A.Words, Low))
+				Array.push_back(Low);
+		}
+		A.Words.clear();
+		A.Words.shrink_to_fit();
+		A.Array.swap(Array);
+		A.Card = A.Array.size();
+		return;
+	}
+
+	if (B.isBitmap()) {
+		auto End = remove_if(A.Array.begin(), A.Array.end(),
+				[&B](uint16_t Low) { return !testBit(B.Words, Low); });
+		A.Array.erase(End, A.Array.end());
+		A.Card = A.Array.size();
+		return;
+	}
+
+	// Both are sorted, so the intersection can be done in place
+	auto Out = A.Array.begin();
+	auto IA = A.Array.begin();
+	auto IB = B.Array.begin();
+	while (IA != A.Array.end() && IB != B.Array.end()) {
+		if (*IA < *IB)
+			++IA;
+		else if (*IB < *IA)
+			++IB;
+		else {
+			*Out++ = *IA;
+			++IA;
+			++IB;
+		}
+	}
+	A.Array.erase(Out, A.Array.end());
+	A.Card = A.Array.size();
+}
+
+void IDBitmap::unionWith(const IDBitmap &B) {
+
+	if (this == &B)
+		return;
+
+	vector<Container> Merged;
+	Merged.reserve(Containers.size() + B.Containers.size());
+	auto IA = Containers.begin();
+	auto IB = B.Containers.begin();
+	while (IA != Containers.end() || IB != B.Containers.end()) {
+		if (IB == B.Containers.end()
+				|| (IA != Containers.end() && IA->Key < IB->Key)) {
+			Merged.push_back(std::move(*IA++));
+		}
+		else if (IA == Containers.end() || IB->Key < IA->Key) {
+			Merged.push_back(*IB++);
+		}
+		else {
+			unionContainer(*IA, *IB++);
+			Merged.push_back(std::move(*IA++));
+		}
+	}
+	Containers.swap(Merged);
+}
+
+void IDBitmap::intersectWith(const IDBitmap &B) {
+
+	if (this == &B)
+		return;
+
+	auto Out = Containers.begin();
+	auto IB = B.Containers.begin();
+	for (auto IA = Containers.begin(); IA != Containers.end(); ++IA) {
+		while (IB != B.Containers.end() && IB->Key < IA->Key)
+			++IB;
+		if (IB == B.Containers.end())
+			break;
+		if (IB->Key != IA->Key)
+			continue;
+
+		intersectContainer(*IA, *IB);
+		if (IA->Card) {
+			if (Out != IA)
+				*Out = std::move(*IA);
+			++Out;
+		}
+	}
+	Containers.erase(Out, Containers.end());
+}
+
+bool IDBitmap::operator==(const IDBitmap &B) const {
+
+	if (Containers.size() != B.Containers.size())
+		return false;
+
+	for (size_t i = 0; i < Containers.size(); ++i) {
+		const Container &CA = Containers[i], &CB = B.Containers[i];
+		// Containers of the same cardinality have the same kind
+		if (CA.Key != CB.Key || CA.Card != CB.Card)
+			return false;
+		if (CA.isBitmap() ? CA.Words != CB.Words : CA.Array != CB.Array)
+			return false;
+	}
+	return true;
+}
+
+uint64_t IDBitmap::hash() const {
+
+	// Equal sets have the same containers of the same kinds
+	uint64_t H = 0;
+	for (const Container &C : Containers) {
+		H = mixHash64(H ^ ((uint64_t)C.Key << 32 | C.Card));
+		if (C.isBitmap()) {
+			for (uint64_t W : C.Words)
+				H = mixHash64(H ^ W);
+		}
+		else {
+			for (uint16_t Low : C.Array)
+				H = mixHash64(H ^ Low);
+		}
+	}
+	return H;
+}
+
+size_t IDBitmap::getMemorySize() const {
+
+	size_t Size = Containers.capacity() * sizeof(Container);
+	for (const Container &C : Containers)
+		Size += C.Array.capacity() * sizeof(uint16_t)
+			+ C.Words.capacity() * sizeof(uint64_t);
+	return Size;
+}
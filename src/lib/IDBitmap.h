@@ -0,0 +1,85 @@
+#ifndef _ID_BITMAP_H
+#define _ID_BITMAP_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+//
+// Compressed bitmap of 32-bit IDs (roaring-style). IDs are split by
+// their high 16 bits into containers. A container keeps its low 16
+// bits in a sorted array while it is sparse, and in a 65536-bit
+// bitmap iff it has more than ARRAY_MAX_CARD members. Set operations
+// work container by container; bitmap containers are combined word by
+// word, with AVX2 if it is enabled.
+//
+class IDBitmap {
+
+	public:
+		// Returns true if ID was not in the set
+		bool insert(uint32_t ID);
+		bool contains(uint32_t ID) const;
+
+		size_t size() const;
+		bool empty() const { return Containers.empty(); }
+		void clear() { Containers.clear(); }
+
+		// In-place union and intersection
+		void unionWith(const IDBitmap &B);
+		void intersectWith(const IDBitmap &B);
+
+		bool operator==(const IDBitmap &B) const;
+		bool operator!=(const IDBitmap &B) const { return !(*this == B); }
+
+		// Hash of the members; equal sets have equal hashes
+		uint64_t hash() const;
+
+		// Visit the IDs in increasing order
+		template <typename FnT>
+		void forEach(FnT Fn) const {
+			for (const Container &C : Containers) {
+				uint32_t High = (uint32_t)C.Key << 16;
+				if (!C.isBitmap()) {
+					for (uint16_t Low : C.Array)
+						Fn(High | Low);
+					continue;
+				}
+				for (uint32_t w = 0; w < C.Words.size(); ++w) {
+					uint64_t W = C.Words[w];
+					while (W) {
+						Fn(High | (w << 6) | __builtin_ctzll(W));
+						W &= W - 1;
+					}
+				}
+			}
+		}
+
+		size_t getMemorySize() const;
+
+	private:
+		struct Container {
+			uint16_t Key = 0;
+			uint32_t Card = 0;
+			// Sorted low bits, for an array container
+			vector<uint16_t> Array;
+			// Bits, for a bitmap container
+			vector<uint64_t> Words;
+
+			bool isBitmap() const { return !Words.empty(); }
+			void toBitmap();
+			void toArray();
+		};
+
+		// Sorted by key; no container is empty
+		vector<Container> Containers;
+
+		vector<Container>::iterator findContainer(uint16_t Key);
+		vector<Container>::const_iterator findContainer(uint16_t Key) const;
+
+		static void unionContainer(Container &A, const Container &B);
+		static void intersectContainer(Container &A, const Container &B);
+};
+
+#endif
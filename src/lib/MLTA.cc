@@ -19,18 +19,19 @@
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/Support/raw_ostream.h"  
 #include "llvm/IR/InstrTypes.h" 
-#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h" 
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/CFG.h" 
+#include "llvm/Support/ThreadPool.h"
 
 #include "Common.h"
 #include "MLTA.h"
 
 #include <map> 
 #include <vector> 
+#include <chrono>
 
 
 using namespace llvm;
@@ -42,8 +43,295 @@ using namespace llvm;
 pair<Type *, int> typeidx_c(Type *Ty, int Idx) {
 	return make_pair(Ty, Idx);
 }
-pair<size_t, int> hashidx_c(size_t Hash, int Idx) {
-	return make_pair(Hash, Idx);
+
+// Linker-like symbol resolution: map the GUID of every external
+// function definition to the definition. It runs once before the
+// analysis, so all later stages can directly store the definitions
+// instead of remapping declarations afterwards.
+void MLTA::resolveSymbols() {
+
+	ModuleList &Modules = Ctx->Modules;
+	vector<vector<pair<uint64_t, Function *>>>ModuleDefs(Modules.size());
+
+	// Modules have their own contexts, so they can be scanned in
+	// parallel
+	ThreadPool Pool;
+	for (unsigned i = 0; i < Modules.size(); ++i) {
+		Module *M = Modules[i].first;
+		vector<pair<uint64_t, Function *>> *Defs = &ModuleDefs[i];
+		Pool.async([M, Defs]() {
+			for (Function &F : *M) {
+				if (F.isDeclaration() || !F.hasExternalLinkage())
+					continue;
+				Defs->push_back(make_pair(F.getGUID(), &F));
+			}
+		});
+	}
+	Pool.wait();
+
+	// Merge in the module order to keep the result deterministic
+	DenseMap<uint64_t, Function *>DefMap;
+	for (auto &Defs : ModuleDefs) {
+		for (auto &Def : Defs)
+			DefMap[Def.first] = Def.second;
+	}
+
+	vector<pair<uint64_t, Function *>>Entries(DefMap.begin(), DefMap.end());
+	Ctx->GlobalFuncMap.build(Entries);
+}
+
+// Get the definition of F; NULL if F is a declaration that is not
+// defined in any module
+Function *MLTA::getFuncDefinition(Function *F) {
+
+	if (!F->isDeclaration())
+		return F;
+
+	if (Function * const *DF = Ctx->GlobalFuncMap.lookup(F->getGUID()))
+		return *DF;
+
+	return NULL;
+}
+
+// The key sets of the phase-1 maps do not change after phase 1, so
+// compile them into read-only tables indexed by type ID, and release
+// the maps. Types first seen in phase 2 are out of the range of the
+// tables and have no entries.
+void MLTA::freezeTypeTables() {
+
+	unsigned NumTypes = typeHashIDs.size();
+
+	Ctx->TypeTableMemory = typeIdxFuncsMap.getMemorySize()
+		+ typeIdxPropMap.getMemorySize();
+	for (auto &IF : typeIdxFuncsMap)
+		Ctx->TypeTableMemory += IF.second.getMemorySize();
+	for (auto &IP : typeIdxPropMap)
+		Ctx->TypeTableMemory += IP.second.capacity() * sizeof(idxkey_t);
+
+	// Keys of a type are adjacent once sorted, as the type ID is
+	// the high half
+	typeIdxFuncsMap.sortByKey();
+	frozenTypeIdxFuncs.assign(NumTypes, IdxRange());
+	for (uint32_t i = 0; i < typeIdxFuncsMap.size(); ++i) {
+		IdxRange &R = frozenTypeIdxFuncs[idxkey_type(typeIdxFuncsMap[i].first)];
+		if (R.Begin == R.End)
+			R.Begin = i;
+		R.End = i + 1;
+	}
+
+	condenseTypePropagation();
+	typeIdxPropMap.clear();
+
+	Ctx->FrozenTypeTableMemory = typeIdxFuncsMap.getMemorySize()
+		+ frozenTypeIdxFuncs.capacity() * sizeof(IdxRange)
+		+ frozenTypeIdxDeps.getMemorySize();
+	for (auto &IF : typeIdxFuncsMap)
+		Ctx->FrozenTypeTableMemory += IF.second.getMemorySize();
+
+	frozenTypeEscapeSet.build(typeEscapeSet.takeKeys());
+
+	frozenTypeCapSet.resize(NumTypes);
+	for (uint64_t TyID : typeCapSet.takeKeys())
+		frozenTypeCapSet.set(TyID);
+
+	Ctx->FrozenTypeTableMemory += frozenTypeEscapeSet.getMemorySize()
+		+ frozenTypeCapSet.getMemorySize();
+
+	sigTargetSets.resize(Ctx->sigFuncsMap.size());
+	for (unsigned i = 0; i < Ctx->sigFuncsMap.size(); ++i)
+		sigTargetSets[i] = Ctx->TargetSets.intern(std::move(Ctx->sigFuncsMap[i]));
+	Ctx->sigFuncsMap.clear();
+	Ctx->sigFuncsMap.shrink_to_fit();
+}
+
+// Precompute the targets that may propagate to every (type, idx)
+// with propagation sources. A (type, idx) depends on its sources and
+// on the sources of (type, -1), transitively; the dependent targets
+// are the union of the targets of all of them. The propagation graph
+// is condensed into strongly connected components, whose members
+// share their closure. Tarjan's algorithm emits the components in
+// reverse topological order, so the closures of the successors of a
+// component are ready when it is emitted.
+void MLTA::condenseTypePropagation() {
+
+	// Number the (type, idx) pairs on the edges; NodeIDs holds ID + 1
+	FlatMap<unsigned> NodeIDs;
+	vector<idxkey_t> Nodes;
+	auto getNode = [&](idxkey_t Key) {
+		unsigned &ID = NodeIDs.getOrInsert(Key);
+		if (!ID) {
+			Nodes.push_back(Key);
+			ID = Nodes.size();
+		}
+		return ID - 1;
+	};
+	for (auto &IP : typeIdxPropMap) {
+		vector<idxkey_t> &Props = IP.second;
+		std::sort(Props.begin(), Props.end());
+		Props.erase(unique(Props.begin(), Props.end()), Props.end());
+		getNode(IP.first);
+		for (idxkey_t Prop : Props)
+			getNode(Prop);
+	}
+
+	// Successors of every node, in CSR form
+	unsigned NumNodes = Nodes.size();
+	vector<unsigned> SuccBegin(NumNodes + 1, 0);
+	vector<unsigned> Succs;
+	for (unsigned N = 0; N < NumNodes; ++N) {
+		SuccBegin[N] = Succs.size();
+		idxkey_t Key = Nodes[N];
+		if (auto *Props = typeIdxPropMap.lookup(Key)) {
+			for (idxkey_t Prop : *Props)
+				Succs.push_back(*NodeIDs.lookup(Prop) - 1);
+		}
+		if (idxkey_idx(Key) == -1)
+			continue;
+		if (auto *Props = typeIdxPropMap.lookup(
+					idxkey_c(idxkey_type(Key), -1))) {
+			for (idxkey_t Prop : *Props)
+				Succs.push_back(*NodeIDs.lookup(Prop) - 1);
+		}
+	}
+	SuccBegin[NumNodes] = Succs.size();
+
+	// Iterative Tarjan's algorithm
+	const unsigned NONE = ~0U;
+	vector<unsigned> Index(NumNodes, NONE), Low(NumNodes), SCCOf(NumNodes, NONE);
+	vector<unsigned> Stack;
+	// (node, next successor to visit)
+	vector<pair<unsigned, unsigned>> CallStack;
+	vector<unsigned> SCCTargets;
+	unsigned NextIndex = 0;
+	IDBitmap FS, Direct;
+
+	for (unsigned Root = 0; Root < NumNodes; ++Root) {
+		if (Index[Root] != NONE)
+			continue;
+
+		CallStack.push_back(make_pair(Root, SuccBegin[Root]));
+		Index[Root] = Low[Root] = NextIndex++;
+		Stack.push_back(Root);
+
+		while (!CallStack.empty()) {
+			unsigned N = CallStack.back().first;
+			unsigned &Next = CallStack.back().second;
+
+			if (Next < SuccBegin[N + 1]) {
+				unsigned S = Succs[Next++];
+				if (Index[S] == NONE) {
+					Index[S] = Low[S] = NextIndex++;
+					Stack.push_back(S);
+					CallStack.push_back(make_pair(S, SuccBegin[S]));
+				}
+				else if (SCCOf[S] == NONE)
+					Low[N] = min(Low[N], Index[S]);
+				continue;
+			}
+
+			CallStack.pop_back();
+			if (!CallStack.empty()) {
+				unsigned P = CallStack.back().first;
+				Low[P] = min(Low[P], Low[N]);
+			}
+			if (Low[N] != Index[N])
+				continue;
+
+			// N is the root of a component; pop its members
+			unsigned SCC = SCCTargets.size();
+			size_t First = Stack.size();
+			do {
+				--First;
+				SCCOf[Stack[First]] = SCC;
+			} while (Stack[First] != N);
+
+			FS.clear();
+			for (size_t i = First; i < Stack.size(); ++i) {
+				unsigned M = Stack[i];
+				getTargetsWithLayerType(idxkey_type(Nodes[M]),
+						idxkey_idx(Nodes[M]), Direct);
+				FS.unionWith(Direct);
+				for (unsigned j = SuccBegin[M]; j < SuccBegin[M + 1]; ++j) {
+					if (SCCOf[Succs[j]] != SCC)
+						FS.unionWith(Ctx->TargetSets.get(SCCTargets[SCCOf[Succs[j]]]));
+				}
+			}
+			Stack.resize(First);
+			SCCTargets.push_back(Ctx->TargetSets.intern(FS));
+		}
+	}
+
+	// The dependent targets of a (type, idx) are the closures of its
+	// successors
+	for (unsigned N = 0; N < NumNodes; ++N) {
+		if (!typeIdxPropMap.lookup(Nodes[N]))
+			continue;
+		FS.clear();
+		for (unsigned j = SuccBegin[N]; j < SuccBegin[N + 1]; ++j)
+			FS.unionWith(Ctx->TargetSets.get(SCCTargets[SCCOf[Succs[j]]]));
+		frozenTypeIdxDeps.getOrInsert(Nodes[N]) = Ctx->TargetSets.intern(FS);
+	}
+}
+
+// Get the signature ID of a function type. The signature is hashed
+// only the first time a type is seen.
+unsigned MLTA::getSigID(FunctionType *FTy) {
+
+	auto it = funcTypeSigIDs.find(FTy);
+	if (it != funcTypeSigIDs.end())
+		return it->second;
+
+	size_t SigHash = funcTypeHash(FTy);
+	auto Ins = sigHashIDs.insert(make_pair(SigHash, sigHashIDs.size()));
+	unsigned SigID = Ins.first->second;
+	funcTypeSigIDs[FTy] = SigID;
+
+	return SigID;
+}
+
+// Get the ID of the type identity of Ty in the type catalog. Types
+// of different modules with the same identity share the ID.
+unsigned MLTA::getTypeID(Type *Ty) {
+
+	auto it = typeIDs.find(Ty);
+	if (it != typeIDs.end())
+		return it->second;
+
+	unsigned TyID = getTypeHashID(typeHash(Ty));
+	typeIDs[Ty] = TyID;
+
+	return TyID;
+}
+
+unsigned MLTA::getTypeHashID(size_t TyHash) {
+
+	auto Ins = typeHashIDs.insert(make_pair(TyHash, typeHashIDs.size()));
+	return Ins.first->second;
+}
+
+unsigned MLTA::getSigTargetSet(unsigned SigID) {
+
+	if (SigID < sigTargetSets.size())
+		return sigTargetSets[SigID];
+
+	return 0;
+}
+
+// Get the dense ID of a target function; IDs are assigned in the
+// order functions are first seen
+unsigned MLTA::getFuncID(Function *F) {
+
+	auto Ins = Ctx->FuncIDs.insert(make_pair(F, Ctx->IDFuncs.size()));
+	if (Ins.second)
+		Ctx->IDFuncs.push_back(F);
+
+	return Ins.first->second;
+}
+
+void MLTA::insertFuncs(const IDBitmap &IDs, FuncSet &FS) {
+	IDs.forEach([&](uint32_t ID) {
+			FS.insert(getFuncByID(ID));
+			});
 }
 
 bool MLTA::fuzzyTypeMatch(Type *Ty1, Type *Ty2, 
@@ -52,6 +340,15 @@ bool MLTA::fuzzyTypeMatch(Type *Ty1, Type *Ty2,
 	if (Ty1 == Ty2)
 		return true;
 
+	auto Ins = fuzzyMatchCache.insert(make_pair(make_pair(Ty1, Ty2), false));
+	if (Ins.second)
+		Ins.first->second = _fuzzyTypeMatch(Ty1, Ty2, M1, M2);
+	return Ins.first->second;
+}
+
+bool MLTA::_fuzzyTypeMatch(Type *Ty1, Type *Ty2, 
+		Module *M1, Module *M2) {
+
 	while (Ty1->isPointerTy() && Ty2->isPointerTy()) {
 		Ty1 = Ty1->getPointerElementType();
 		Ty2 = Ty2->getPointerElementType();
@@ -81,45 +378,100 @@ bool MLTA::fuzzyTypeMatch(Type *Ty1, Type *Ty2,
 }
 
 
+// Coarse class of a type for fuzzy matching. Matching pointers are
+// stripped in lockstep, so the pointer depth and the kind of the base
+// type must agree; integers and general pointers may match across
+// depths, so all integer-based types share one class.
+static uint64_t fuzzyTypeClass(Type *Ty) {
+
+	uint64_t Depth = 0;
+	while (Ty->isPointerTy()) {
+		Ty = Ty->getPointerElementType();
+		++Depth;
+	}
+
+	if (Ty->isIntegerTy())
+		return 0;
+	if (Ty->isStructTy())
+		return (Depth << 2) | 1;
+	return (Depth << 2) | 2;
+}
+
+// Bucket key of a function type, from its arity and type classes
+static uint64_t fuzzySigKey(FunctionType *FTy) {
+
+	uint64_t Key = mixHash64(FTy->getNumParams());
+	Key = mixHash64(Key ^ fuzzyTypeClass(FTy->getReturnType()));
+	for (Type *PTy : FTy->params())
+		Key = mixHash64(Key ^ fuzzyTypeClass(PTy));
+	return Key;
+}
+
+// Bucket key of a callsite, from its actual args; they may outnumber
+// the params of a variadic call
+static uint64_t fuzzySigKey(CallBase *CB) {
+
+	uint64_t Key = mixHash64(CB->arg_size());
+	Key = mixHash64(Key ^ fuzzyTypeClass(CB->getType()));
+	for (Value *Arg : CB->args())
+		Key = mixHash64(Key ^ fuzzyTypeClass(Arg->getType()));
+	return Key;
+}
+
+void MLTA::buildFuzzyIndex() {
+
+	for (Function *F : Ctx->AddressTakenFuncs) {
+
+		if (F->isIntrinsic())
+			continue;
+
+		Function *DF = getFuncDefinition(F);
+		if (!DF)
+			continue;
+
+		FuzzyCand C = {F, getFuncID(DF)};
+		if (F->getFunctionType()->isVarArg())
+			fuzzyVarArgFuncs.push_back(C);
+		else
+			fuzzyFuncBuckets.getOrInsert(fuzzySigKey(F->getFunctionType()))
+				.push_back(C);
+	}
+	fuzzyIndexBuilt = true;
+}
+
 // Find targets of indirect calls based on function-type analysis: as
 // long as the number and type of parameters of a function matches
 // with the ones of the callsite, we say the function is a possible
 // target of this call.
-void MLTA::findCalleesWithType(CallInst *CI, FuncSet &S) {
+unsigned MLTA::findCalleesWithType(CallInst *CI) {
 
 	if (CI->isInlineAsm())
-		return;
+		return 0;
 
 	//
 	// Performance improvement: cache results for types
 	//
-	size_t CIH = callHash(CI);
-	if (MatchedFuncsMap.find(CIH) != MatchedFuncsMap.end()) {
-		if (!MatchedFuncsMap[CIH].empty())
-			S.insert(MatchedFuncsMap[CIH].begin(), 
-					MatchedFuncsMap[CIH].end());
-		return;
-	}
+	unsigned SigID = callSigID(CI);
+	auto MI = MatchedICallTypeMap.find(SigID);
+	if (MI != MatchedICallTypeMap.end())
+		return MI->second;
 
-	CallBase *CB = dyn_cast<CallBase>(CI);
-	for (Function *F : Ctx->AddressTakenFuncs) {
-		// VarArg
-		if (F->getFunctionType()->isVarArg()) {
-			// Compare only known args in VarArg.
-		}
-		// otherwise, the numbers of args should be equal.
-		else if (F->arg_size() != CB->arg_size()) {
-			continue;
-		}
+	if (!fuzzyIndexBuilt)
+		buildFuzzyIndex();
 
-		if (F->isIntrinsic()) {
-			continue;
-		}
+	IDBitmap MatchedFS;
+
+	CallBase *CB = dyn_cast<CallBase>(CI);
+	// Candidates: variadic functions, for which only the known args
+	// are compared, and the functions whose arity and type classes
+	// equal the ones of the callsite
+	auto Check = [&](const FuzzyCand &C) {
+		Function *F = C.F;
 
 		// Types completely match
-		if (callHash(CI) == funcHash(F)) {
-			S.insert(F);
-			continue;
+		if (funcSigID(F) == SigID) {
+			MatchedFS.insert(C.DefID);
+			return;
 		}
 
 		Module *CalleeM = F->getParent();
@@ -153,108 +505,26 @@ void MLTA::findCalleesWithType(CallInst *CI, FuncSet &S) {
 		}
 
 		if (Matched) {
-			S.insert(F);
+			MatchedFS.insert(C.DefID);
 		}
-	}
-	MatchedFuncsMap[CIH] = S;
-}
+	};
 
-
-void MLTA::unrollLoops(Function *F) {
-
-	if (F->isDeclaration())
-		return;
-
-	DominatorTree DT = DominatorTree();
-	DT.recalculate(*F);
-	LoopInfo *LI = new LoopInfo();
-	LI->releaseMemory();
-	LI->analyze(DT);
-
-	// Collect all loops in the function
-	set<Loop *> LPSet;
-	for (LoopInfo::iterator i = LI->begin(), e = LI->end(); i!=e; ++i) {
-
-		Loop *LP = *i;
-		LPSet.insert(LP);
-
-		list<Loop *> LPL;
-
-		LPL.push_back(LP);
-		while (!LPL.empty()) {
-			LP = LPL.front();
-			LPL.pop_front();
-			vector<Loop *> SubLPs = LP->getSubLoops();
-			for (auto SubLP : SubLPs) {
-				LPSet.insert(SubLP);
-				LPL.push_back(SubLP);
-			}
-		}
-	}
-
-	for (Loop *LP : LPSet) {
-
-		// Get the header,latch block, exiting block of every loop
-		BasicBlock *HeaderB = LP->getHeader();
-
-		unsigned NumBE = LP->getNumBackEdges();
-		SmallVector<BasicBlock *, 4> LatchBS;
-
-		LP->getLoopLatches(LatchBS);
-
-		for (BasicBlock *LatchB : LatchBS) {
-			if (!HeaderB || !LatchB) {
-				OP<<"ERROR: Cannot find Header Block or Latch Block\n";
-				continue;
-			}
-			// Two cases:
-			// 1. Latch Block has only one successor:
-			// 	for loop or while loop;
-			// 	In this case: set the Successor of Latch Block to the 
-			//	successor block (out of loop one) of Header block
-			// 2. Latch Block has two successor: 
-			// do-while loop:
-			// In this case: set the Successor of Latch Block to the
-			//  another successor block of Latch block 
-
-			// get the last instruction in the Latch block
-			Instruction *TI = LatchB->getTerminator();
-			// Case 1:
-			if (LatchB->getSingleSuccessor() != NULL) {
-				for (succ_iterator sit = succ_begin(HeaderB); 
-						sit != succ_end(HeaderB); ++sit) {  
-
-					BasicBlock *SuccB = *sit;	
-					BasicBlockEdge BBE = BasicBlockEdge(HeaderB, SuccB);
-					// Header block has two successor,
-					// one edge dominate Latch block;
-					// another does not.
-					if (DT.dominates(BBE, LatchB))
-						continue;
-					else {
-						TI->setSuccessor(0, SuccB);
-					}
-				}
-			}
-			// Case 2:
-			else {
-				for (succ_iterator sit = succ_begin(LatchB); 
-						sit != succ_end(LatchB); ++sit) {
-
-					BasicBlock *SuccB = *sit;
-					// There will be two successor blocks, one is header
-					// we need successor to be another
-					if (SuccB == HeaderB)
-						continue;
-					else{
-						TI->setSuccessor(0, SuccB);
-					}
-				}	
-			}
+	for (const FuzzyCand &C : fuzzyVarArgFuncs)
+		Check(C);
+	if (const vector<FuzzyCand> *Bucket =
+			fuzzyFuncBuckets.lookup(fuzzySigKey(CB))) {
+		for (const FuzzyCand &C : *Bucket) {
+			// Buckets may collide
+			if (C.F->arg_size() == CB->arg_size())
+				Check(C);
 		}
 	}
+	unsigned SetID = Ctx->TargetSets.intern(std::move(MatchedFS));
+	MatchedICallTypeMap[SigID] = SetID;
+	return SetID;
 }
 
+
 bool MLTA::isCompositeType(Type *Ty) {
 	if (Ty->isStructTy() 
 			|| Ty->isArrayTy() 
@@ -277,15 +547,40 @@ Type *MLTA::getFuncPtrType(Value *V) {
 
 Value *MLTA::recoverBaseType(Value *V) {
 	if (Instruction *I = dyn_cast<Instruction>(V)) {
-		map<Value *, Value *> &AliasMap 
-			= AliasStructPtrMap[I->getFunction()];
-		if (AliasMap.find(V) != AliasMap.end()) {
-			return AliasMap[V];
-		}
+		if (I->getFunction() != AliasFunc)
+			collectAliasStructPtr(I->getFunction());
+		auto it = lower_bound(AliasStructPtrs.begin(), AliasStructPtrs.end(), V,
+				[](const pair<Value *, Value *> &A, Value *K) {
+				return A.first < K;
+				});
+		if (it != AliasStructPtrs.end() && it->first == V)
+			return it->second;
 	}
 	return NULL;
 }
 
+// Type IDs of a container type of the current global; a struct
+// type has one per struct hash
+ArrayRef<unsigned> MLTA::getContainerTyIDs(Type *CTy) {
+
+	auto Ins = InitContainerTyIDs.insert(make_pair(CTy,
+				make_pair((unsigned)InitTyIDPool.size(), 0U)));
+	auto &Range = Ins.first->second;
+	if (Ins.second) {
+		set<size_t> TyHS;
+		if (StructType *STy = dyn_cast<StructType>(CTy)) {
+			structTypeHash(STy, TyHS);
+		}
+		else
+			TyHS.insert(typeHash(CTy));
+
+		for (auto TyH : TyHS)
+			InitTyIDPool.push_back(getTypeHashID(TyH));
+		Range.second = InitTyIDPool.size() - Range.first;
+	}
+	return makeArrayRef(InitTyIDPool).slice(Range.first, Range.second);
+}
+
 // This function analyzes globals to collect information about which
 // types functions have been assigned to.
 // The analysis is field sensitive.
@@ -295,20 +590,19 @@ bool MLTA::typeConfineInInitializer(GlobalVariable *GV) {
 	if (!isa<ConstantAggregate>(Ini))
 		return false;
 
-	list<pair<Type *, int>>NestedInit;
-	map<Value *, pair<Value *, int>>ContainersMap;
-	set<Value *>FuncOperands;
-	list<User *>LU;
-	set<Value *>Visited;
-	LU.push_back(Ini);
-
-	while (!LU.empty()) {
-		User *U = LU.front();
-		LU.pop_front();
-		if (Visited.find(U) != Visited.end()) {
+	InitContainers.clear();
+	InitContainerTyIDs.clear();
+	InitTyIDPool.clear();
+	InitWorklist.clear();
+	InitVisited.clear();
+	InitWorklist.push_back(Ini);
+
+	// The worklist is consumed in FIFO order
+	for (size_t Head = 0; Head < InitWorklist.size(); ++Head) {
+		User *U = InitWorklist[Head];
+		if (!InitVisited.insert(U).second) {
 			continue;
 		}
-		Visited.insert(U);
 
 		Type *UTy = U->getType();
 		assert(!UTy->isFunctionTy());
@@ -326,7 +620,7 @@ bool MLTA::typeConfineInInitializer(GlobalVariable *GV) {
 			Value *O = *oi;
 			Type *OTy = O->getType();
 
-			ContainersMap[O] = make_pair(U, oi->getOperandNo());
+			InitContainers[O] = make_pair(U, oi->getOperandNo());
 
 			Function *FoundF = NULL;
 			// Case 1: function address is assigned to a type
@@ -342,7 +636,7 @@ bool MLTA::typeConfineInInitializer(GlobalVariable *GV) {
 
 				// recognize nested composite types
 				User *OU = dyn_cast<User>(O);
-				LU.push_back(OU);
+				InitWorklist.push_back(OU);
 			}
 			else if (PtrToIntOperator *PIO = dyn_cast<PtrToIntOperator>(O)) {
 
@@ -351,7 +645,7 @@ bool MLTA::typeConfineInInitializer(GlobalVariable *GV) {
 					FoundF = F;
 				else {
 					User *OU = dyn_cast<User>(PIO->getOperand(0));
-					LU.push_back(OU);
+					InitWorklist.push_back(OU);
 				}
 			}
 			// now consider if it is a bitcast from a function
@@ -371,7 +665,7 @@ bool MLTA::typeConfineInInitializer(GlobalVariable *GV) {
 				}
 				else {
 					User *OU = dyn_cast<User>(CO->getOperand(0));
-					LU.push_back(OU);
+					InitWorklist.push_back(OU);
 				}
 			}
 			// Case 3: a reference (i.e., pointer) of a composite-type
@@ -384,12 +678,12 @@ bool MLTA::typeConfineInInitializer(GlobalVariable *GV) {
 				// treat it as a type cap (we cannot get the next-layer type
 				// if the type is a cap)
 				User *OU = dyn_cast<User>(O);
-				LU.push_back(OU);
+				InitWorklist.push_back(OU);
 				if (GlobalVariable *GO = dyn_cast<GlobalVariable>(OU)) {
 					Type *Ty = POTy->getPointerElementType();
 					// FIXME: take it as a confinement instead of a cap
 					if (Ty->isStructTy())
-						typeCapSet.insert(typeHash(Ty));
+						typeCapSet.insert(getTypeID(Ty));
 				}
 			}
 			else {
@@ -404,37 +698,40 @@ bool MLTA::typeConfineInInitializer(GlobalVariable *GV) {
 				if (GV->getName() != "llvm.compiler.used")
 					StoredFuncs.insert(FoundF);
 
+				// Only definitions can be targets
+				Function *DF = getFuncDefinition(FoundF);
+				if (!DF)
+					continue;
+
 				// Add the function type to all containers
 				Value *CV = O;
-				set<Value *>Visited; // to avoid loop
-				while (ContainersMap.find(CV) != ContainersMap.end()) {
-					auto Container = ContainersMap[CV];
+				InitChainVisited.clear(); // to avoid loop
+				for (auto it = InitContainers.find(CV);
+						it != InitContainers.end();
+						it = InitContainers.find(CV)) {
+					auto Container = it->second;
 
 					Type *CTy = Container.first->getType();
-					set<size_t> TyHS;
-					if (StructType *STy = dyn_cast<StructType>(CTy)) {
-						structTypeHash(STy, TyHS);
-					}
-					else
-						TyHS.insert(typeHash(CTy));
 
 					DBG<<"[INSERT-INIT] Container type: "<<*CTy
 						<<"; Idx: "<<Container.second
 						<<"\n\t --> FUNC: "<<FoundF->getName()<<"; Module: "
 						<<FoundF->getParent()->getName()<<"\n";
 					
-					for (auto TyH : TyHS) {
+					for (unsigned TyID : getContainerTyIDs(CTy)) {
 #ifdef MLTA_FIELD_INSENSITIVE 
-						typeIdxFuncsMap[TyH][0].insert(FoundF);
+						typeIdxFuncsMap.getOrInsert(idxkey_c(TyID, 0))
+							.insert(getFuncID(DF));
 #else
-						typeIdxFuncsMap[TyH][Container.second].insert(FoundF);
+						typeIdxFuncsMap.getOrInsert(idxkey_c(TyID, Container.second))
+							.insert(getFuncID(DF));
 #endif
-						DBG<<"[HASH] "<<TyH<<"\n";
+						DBG<<"[TYPE-ID] "<<TyID<<"\n";
 
 					}
 
-					Visited.insert(CV);
-					if (Visited.find(Container.first) != Visited.end())
+					InitChainVisited.insert(CV);
+					if (InitChainVisited.count(Container.first))
 						break;
 
 					CV = Container.first;
@@ -483,8 +780,7 @@ bool MLTA::typeConfineInFunction(Function *F) {
 					Function *CF = dyn_cast<Function>(CV);
 					if (!CF)
 						continue;
-					if (CF->isDeclaration())
-						CF = Ctx->GlobalFuncMap[CF->getGUID()];
+					CF = getFuncDefinition(CF);
 					if (!CF)
 						continue;
 					if (Argument *Arg = getParamByArgNo(CF, OI->getOperandNo())) {
@@ -541,10 +837,9 @@ bool MLTA::typePropInFunction(Function *F) {
 			if (isa<ConstantAggregate>(VO) || isa<ConstantData>(VO))
 				continue;
 
-			list<typeidx_t>TyList;
+			typeidx_list_t TyList;
 			Value *NextV = NULL;
-			set<Value *> Visited;
-			nextLayerBaseType(VO, TyList, NextV, Visited);
+			nextLayerBaseTypeMemo(VO, TyList, NextV);
 			if (!TyList.empty()) {
 				for (auto TyIdx : TyList) {
 					propagateType(PO, TyIdx.first, TyIdx.second);
@@ -552,7 +847,7 @@ bool MLTA::typePropInFunction(Function *F) {
 				continue;
 			}
 
-			Visited.clear();
+			VisitSet Visited;
 			Type *BTy = getBaseType(VO, Visited);
 			// Composite type
 			if (BTy) {
@@ -622,8 +917,8 @@ bool MLTA::typePropInFunction(Function *F) {
 // This function precisely collect alias types for general pointers
 void MLTA::collectAliasStructPtr(Function *F) {
 
-	map<Value *, Value *> &AliasMap = AliasStructPtrMap[F];
-	set<Value *>ToErase;
+	AliasFunc = F;
+	AliasStructPtrs.clear();
 	for (inst_iterator i = inst_begin(F), e = inst_end(F); 
 			i != e; ++i) {
 
@@ -646,26 +941,46 @@ void MLTA::collectAliasStructPtr(Function *F) {
 			if (!isCompositeType(ToTy->getPointerElementType()))
 				continue;
 
-			if (AliasMap.find(FromV) != AliasMap.end()) {
-				ToErase.insert(FromV);
-				continue;
-			}
-			AliasMap[FromV] = CI;
+			AliasStructPtrs.push_back(make_pair(FromV, CI));
 		}
 	}
-	for (auto Erase : ToErase)
-		AliasMap.erase(Erase);
+
+	// A general pointer cast more than once has no alias
+	std::sort(AliasStructPtrs.begin(), AliasStructPtrs.end(),
+			[](const pair<Value *, Value *> &A,
+				const pair<Value *, Value *> &B) {
+			return A.first < B.first;
+			});
+	size_t Out = 0;
+	for (size_t i = 0; i < AliasStructPtrs.size(); ) {
+		size_t j = i + 1;
+		while (j < AliasStructPtrs.size()
+				&& AliasStructPtrs[j].first == AliasStructPtrs[i].first)
+			++j;
+		if (j == i + 1)
+			AliasStructPtrs[Out++] = AliasStructPtrs[i];
+		i = j;
+	}
+	AliasStructPtrs.resize(Out);
+}
+
+void MLTA::evictFunctionCaches() {
+	AliasFunc = NULL;
+	AliasStructPtrs.clear();
+	ChainMemo.clear();
+	LayerMemo.clear();
+	WalkTypes.clear();
 }
 
 
 void MLTA::escapeType(Value *V) {
 
-	list<typeidx_t> TyChain;
+	typeidx_list_t TyChain;
 	bool Complete = true;
 	getBaseTypeChain(TyChain, V, Complete);
 	for (auto T : TyChain) {
 		DBG<<"[Escape] Type: "<<*(T.first)<<"; Idx: "<<T.second<<"\n";
-		typeEscapeSet.insert(typeIdxHash(T.first, T.second));
+		typeEscapeSet.insert(idxkey_c(getTypeID(T.first), T.second));
 	}
 }
 
@@ -675,7 +990,11 @@ void MLTA::confineTargetFunction(Value *V, Function *F) {
 
 	StoredFuncs.insert(F);
 
-	list<typeidx_t> TyChain;
+	// Declarations without a definition cannot be targets, but they
+	// still decide the caps
+	Function *DF = getFuncDefinition(F);
+
+	typeidx_list_t TyChain;
 	bool Complete = true;
 	getBaseTypeChain(TyChain, V, Complete);
 	for (auto TI : TyChain) {
@@ -683,42 +1002,37 @@ void MLTA::confineTargetFunction(Value *V, Function *F) {
 			<<"\n\t --> FUNC:  "<<F->getName()<<"; Module: "
 			<<F->getParent()->getName()<<"\n";
 		DBG<<"[HASH] "<<typeHash(TI.first)<<"\n";
-		typeIdxFuncsMap[typeHash(TI.first)][TI.second].insert(F);
+		if (DF)
+			typeIdxFuncsMap.getOrInsert(idxkey_c(getTypeID(TI.first), TI.second))
+				.insert(getFuncID(DF));
 	}
 	if (!Complete) {
 		if (!TyChain.empty())
-			typeCapSet.insert(typeHash(TyChain.back().first));
+			typeCapSet.insert(getTypeID(TyChain.back().first));
 		else
-			typeCapSet.insert(funcHash(F));
+			typeCapSet.insert(getTypeHashID(funcHash(F)));
 	}
 }
 
 void MLTA::propagateType(Value *ToV, Type *FromTy, int Idx) {
 
-	list<typeidx_t> TyChain;
+	typeidx_list_t TyChain;
 	bool Complete = true;
 	getBaseTypeChain(TyChain, ToV, Complete);
 	for (auto T : TyChain) {
 		
-		if (typeHash(T.first) == typeHash(FromTy) && T.second == Idx)
+		unsigned ToID = getTypeID(T.first);
+		unsigned FromID = getTypeID(FromTy);
+		if (ToID == FromID && T.second == Idx)
 			continue;
 
-		typeIdxPropMap[typeHash(T.first)]
-			[T.second].insert(hashidx_c(typeHash(FromTy), Idx));
+		typeIdxPropMap.getOrInsert(idxkey_c(ToID, T.second))
+			.push_back(idxkey_c(FromID, Idx));
 		DBG<<"[PROP] "<<*(FromTy)<<": "<<Idx
 			<<"\n\t===> "<<*(T.first)<<" "<<T.second<<"\n";
 	}
 }
 
-void MLTA::intersectFuncSets(FuncSet &FS1, FuncSet &FS2, 
-		FuncSet &FS) {
-	FS.clear();
-	for (auto F : FS1) {
-		if (FS2.find(F) != FS2.end())
-			FS.insert(F);
-	}
-}
-
 Value *MLTA::getVTable(Value *V) {
 	if (BitCastOperator *BCO =
 			dyn_cast<BitCastOperator>(V)) {
@@ -777,19 +1091,17 @@ void MLTA::saveCalleesInfo(CallInst *CI, FuncSet &FS,
 	}
 }
 
-void MLTA::printTypeChain(list<typeidx_t> &Chain) {
+void MLTA::printTypeChain(typeidx_list_t &Chain) {
 	if (Chain.empty())
 		return;
 
-	for (list<typeidx_t>::iterator it = Chain.begin(); 
-			it != Chain.end(); ++it) {
-		typeidx_t TI = *it;
+	for (typeidx_t TI : Chain) {
 		OP<<"--<"<<*(TI.first)<<", "<<TI.second<<">";
 	}
 	OP<<"\n";
 }
 
-void MLTA::printTargets(FuncSet &FS, CallInst *CI) {
+void MLTA::printTargets(const IDBitmap &FS, CallInst *CI) {
 
 	if (CI) {
 #ifdef PRINT_SOURCE_LINE
@@ -800,13 +1112,14 @@ void MLTA::printTargets(FuncSet &FS, CallInst *CI) {
 		//WriteSourceInfoIntoFile(CI, "IcallInfo.txt");
 	}
 	OP<<"\n\t Indirect-call targets: ("<<FS.size()<<")\n";
-	for (auto F : FS) {
+	FS.forEach([&](uint32_t ID) {
+		Function *F = getFuncByID(ID);
 		if (F->isDeclaration()) {
 			OP<<"ERROR: print declaration function: "<<F->getName()<<"\n";
-			continue;
+			return;
 		}
 		printSourceCodeInfo(F, "TARGET");
-	}
+	});
 	OP<<"\n";
 
 #if 0
@@ -820,13 +1133,24 @@ void MLTA::printTargets(FuncSet &FS, CallInst *CI) {
 // Get the chain of base types for V
 // Complete: whether the chain's end is not escaping---it won't
 // propagate further
-bool MLTA::getBaseTypeChain(list<typeidx_t> &Chain, Value *V,
+bool MLTA::getBaseTypeChain(typeidx_list_t &Chain, Value *V,
 		bool &Complete) {
 
+	auto it = ChainMemo.find(V);
+	if (it != ChainMemo.end()) {
+		// The cap has been recorded by the first walk
+		const WalkResult &R = it->second;
+		Chain.append(WalkTypes.begin() + R.Begin,
+				WalkTypes.begin() + R.Begin + R.Len);
+		Complete = R.Flag;
+		++Ctx->NumTypeWalkMemoHits;
+		return true;
+	}
+
+	size_t Start = Chain.size();
 	Complete = true;
 	Value *CV = V, *NextV = NULL;
-	list<typeidx_t> TyList;
-	set<Value *>Visited;
+	VisitSet Visited;
 
 	Type *BTy = getBaseType(V, Visited);
 	if (BTy) {
@@ -835,12 +1159,11 @@ bool MLTA::getBaseTypeChain(list<typeidx_t> &Chain, Value *V,
 	}
 	Visited.clear();
 
-	while (nextLayerBaseType(CV, TyList, NextV, Visited)) {
+	// The next layers are appended after the base type
+	while (nextLayerBaseType(CV, Chain, NextV, Visited)) {
 		CV = NextV;
 	}
-	for (auto TyIdx : TyList) {
-		Chain.push_back(typeidx_c(TyIdx.first, TyIdx.second));
-	}
+	countWalk(Visited, Chain);
 
 	// Checking completeness
 	if (!NextV) {
@@ -862,23 +1185,35 @@ bool MLTA::getBaseTypeChain(list<typeidx_t> &Chain, Value *V,
 	}
 
 	if (!Chain.empty() && !Complete) {
-		typeCapSet.insert(typeHash(Chain.back().first));
+		typeCapSet.insert(getTypeID(Chain.back().first));
 	}
 
+	WalkResult R = {(uint32_t)WalkTypes.size(),
+		(uint32_t)(Chain.size() - Start), NextV, Complete};
+	WalkTypes.insert(WalkTypes.end(), Chain.begin() + Start, Chain.end());
+	ChainMemo[V] = R;
+
 	return true;
 }
 
+void MLTA::countWalk(const VisitSet &Visited,
+		const typeidx_list_t &TyList) {
+
+	++Ctx->NumTypeWalks;
+	if (Visited.spilled() || TyList.capacity() > MAX_TYPE_LAYER)
+		++Ctx->NumTypeWalkSpills;
+}
+
 // This function is to get the base type in the current layer.
 // To get the type of next layer (with GEP and Load), use
 // nextLayerBaseType() instead.
-Type *MLTA::getBaseType(Value *V, set<Value *> &Visited) {
+Type *MLTA::getBaseType(Value *V, VisitSet &Visited) {
 
 	if (!V)
 		return NULL;
 
-	if (Visited.find(V) != Visited.end())
+	if (!Visited.insert(V))
 		return NULL;
-	Visited.insert(V);
 
 	Type *Ty = V->getType();
 
@@ -921,7 +1256,7 @@ Type *MLTA::getBaseType(Value *V, set<Value *> &Visited) {
 	return NULL;
 }
 
-Type *MLTA::_getPhiBaseType(PHINode *PN, set<Value *> &Visited) {
+Type *MLTA::_getPhiBaseType(PHINode *PN, VisitSet &Visited) {
 
 	for (unsigned i = 0, e = PN->getNumIncomingValues(); i != e; ++i) {
 		Value *IV = PN->getIncomingValue(i);
@@ -934,13 +1269,15 @@ Type *MLTA::_getPhiBaseType(PHINode *PN, set<Value *> &Visited) {
 	return NULL;
 }
 
-bool MLTA::getGEPLayerTypes(GEPOperator *GEP, list<typeidx_t> &TyList) {
+bool MLTA::getGEPLayerTypes(GEPOperator *GEP, typeidx_list_t &TyList) {
 
 	Value *PO = GEP->getPointerOperand();
 	Type *ETy = GEP->getSourceElementType();
 
-	vector<int> Indices; 
-	list<typeidx_t> TmpTyList;
+	SmallVector<int, MAX_TYPE_LAYER> Indices; 
+	// The layer types of this GEP are appended innermost first and
+	// reversed at the end
+	size_t Start = TyList.size();
 	// FIXME: handle downcasting: the GEP may get a field outside the
 	// base type
 	// Or use O0 to avoid this issue
@@ -999,9 +1336,9 @@ bool MLTA::getGEPLayerTypes(GEPOperator *GEP, list<typeidx_t> &TyList) {
 
 		int Idx = *it;
 #ifdef MLTA_FIELD_INSENSITIVE
-		TmpTyList.push_front(typeidx_c(ETy, 0));
+		TyList.push_back(typeidx_c(ETy, 0));
 #else
-		TmpTyList.push_front(typeidx_c(ETy, Idx));
+		TyList.push_back(typeidx_c(ETy, Idx));
 #endif
 
 		// Continue to parse subty
@@ -1034,39 +1371,36 @@ bool MLTA::getGEPLayerTypes(GEPOperator *GEP, list<typeidx_t> &TyList) {
 
 					Type *ToTy = PTy->getPointerElementType();
 					if (Ty0 == ToTy)
-						TmpTyList.push_front(typeidx_c(ETy, 0));
+						TyList.push_back(typeidx_c(ETy, 0));
 				}
 			}
 		}
 	}
 
-	if (!TmpTyList.empty()) {
+	if (TyList.size() > Start) {
 		// Reorder
-		for (auto TyIdx : TmpTyList) {
-			TyList.push_back(TyIdx);
-		}
+		std::reverse(TyList.begin() + Start, TyList.end());
 		return true;
 	}
 	else
 		return false;
 }
 
-bool MLTA::nextLayerBaseTypeWL(Value *V, list<typeidx_t> &TyList,
+bool MLTA::nextLayerBaseTypeWL(Value *V, typeidx_list_t &TyList,
 		Value * &NextV) {
 
-	list<Value *> VL;
-	set<Value *>Visited;
+	SmallVector<Value *, 8> VL;
+	VisitSet Visited;
 	VL.push_back(V);
 
-	while (!VL.empty()) {
+	// The worklist is consumed in FIFO order
+	for (size_t Head = 0; Head < VL.size(); ++Head) {
 
-		Value *CV = VL.front();
-		VL.pop_front();
-		if (Visited.find(CV) != Visited.end()) {
+		Value *CV = VL[Head];
+		if (!Visited.insert(CV)) {
 			NextV = CV;
 			continue;
 		}
-		Visited.insert(CV);
 
 		if (!CV || isa<Argument>(CV)) {
 			NextV = CV;
@@ -1116,21 +1450,45 @@ bool MLTA::nextLayerBaseTypeWL(Value *V, list<typeidx_t> &TyList,
 	return (V != NextV);
 }
 
+bool MLTA::nextLayerBaseTypeMemo(Value *V, typeidx_list_t &TyList, 
+		Value * &NextV) {
+
+	auto it = LayerMemo.find(V);
+	if (it != LayerMemo.end()) {
+		const WalkResult &R = it->second;
+		TyList.append(WalkTypes.begin() + R.Begin,
+				WalkTypes.begin() + R.Begin + R.Len);
+		NextV = R.NextV;
+		++Ctx->NumTypeWalkMemoHits;
+		return R.Flag;
+	}
+
+	size_t Start = TyList.size();
+	VisitSet Visited;
+	bool ret = nextLayerBaseType(V, TyList, NextV, Visited);
+	countWalk(Visited, TyList);
+
+	WalkResult R = {(uint32_t)WalkTypes.size(),
+		(uint32_t)(TyList.size() - Start), NextV, ret};
+	WalkTypes.insert(WalkTypes.end(), TyList.begin() + Start, TyList.end());
+	LayerMemo[V] = R;
+	return ret;
+}
+
 // Get the composite type of the lower layer. Layers are split by
 // memory loads or GEP
-bool MLTA::nextLayerBaseType(Value *V, list<typeidx_t> &TyList, 
-		Value * &NextV, set<Value *> &Visited) {
+bool MLTA::nextLayerBaseType(Value *V, typeidx_list_t &TyList, 
+		Value * &NextV, VisitSet &Visited) {
 
 	if (!V || isa<Argument>(V)) {
 		NextV = V;
 		return false;
 	}
 
-	if (Visited.find(V) != Visited.end()) {
+	if (!Visited.insert(V)) {
 		NextV = V;
 		return false;
 	}
-	Visited.insert(V);
 
 	// The only way to get the next layer type: GetElementPtrInst or
 	// GEPOperator
@@ -1156,21 +1514,23 @@ bool MLTA::nextLayerBaseType(Value *V, list<typeidx_t> &TyList,
 	// Phi and Select 
 	else if (PHINode *PN = dyn_cast<PHINode>(V)) {
 		// FIXME: tracking incoming values
+		// Every incoming value is walked from the state at the PHI,
+		// and the walk of the last one tried is kept
 		bool ret = false;
-		set<Value *> NVisited;
-		list<typeidx_t> NTyList;
+		size_t Size = TyList.size();
+		size_t Mark = Visited.mark();
 		for (unsigned i = 0, e = PN->getNumIncomingValues(); i != e; ++i) {
+			if (i > 0) {
+				TyList.truncate(Size);
+				Visited.rollback(Mark);
+			}
 			Value *IV = PN->getIncomingValue(i);
 			NextV = IV;
-			NVisited = Visited;
-			NTyList = TyList;
-			ret = nextLayerBaseType(IV, NTyList, NextV, NVisited);
-			if (NTyList.size() > TyList.size()) {
+			ret = nextLayerBaseType(IV, TyList, NextV, Visited);
+			if (TyList.size() > Size) {
 				break;
 			}
 		}
-		TyList = NTyList;
-		Visited = NVisited;
 		return ret;
 	}
 	else if (SelectInst *SelI = dyn_cast<SelectInst>(V)) {
@@ -1191,31 +1551,25 @@ bool MLTA::nextLayerBaseType(Value *V, list<typeidx_t> &TyList,
 	return false;
 }
 
-bool MLTA::getDependentTypes(Type *Ty, int Idx, 
-		set<hashidx_t> &PropSet) {
-
-	list<hashidx_t>LT;
-	LT.push_back(hashidx_c(typeHash(Ty), Idx));
-	set<hashidx_t>Visited;
-
-	while (!LT.empty()) {
-		hashidx_t TI = LT.front();
-		LT.pop_front();
-		if (Visited.find(TI) != Visited.end()) {
-			continue;
-		}
-		Visited.insert(TI);
-
-		for (auto Prop : typeIdxPropMap[TI.first][TI.second]) {
-			PropSet.insert(Prop);
-			LT.push_back(Prop);
-		}
-		for (auto Prop : typeIdxPropMap[TI.first][-1]) {
-			PropSet.insert(Prop);
-			LT.push_back(Prop);
-		}
-	}
-	return true;
+// Get the targets of the types that may propagate targets to the
+// given type, as a set ID
+unsigned MLTA::getDependentTargets(unsigned TyID, int Idx) {
+
+	++Ctx->NumTypeTableLookups;
+	if (const unsigned *SetID = frozenTypeIdxDeps.lookup(idxkey_c(TyID, Idx))) {
+		++Ctx->NumTypeTableHits;
+		return *SetID;
+	}
+	// Without sources of its own, a field only depends on the sources
+	// of all fields
+	if (Idx == -1)
+		return 0;
+	++Ctx->NumTypeTableLookups;
+	if (const unsigned *SetID = frozenTypeIdxDeps.lookup(idxkey_c(TyID, -1))) {
+		++Ctx->NumTypeTableHits;
+		return *SetID;
+	}
+	return 0;
 }
 
 
@@ -1238,40 +1592,54 @@ Function *MLTA::getBaseFunction(Value *V) {
 }
 
 // Get all possible targets of the given type
-bool MLTA::getTargetsWithLayerType(size_t TyHash, int Idx, 
-		FuncSet &FS) {
+bool MLTA::getTargetsWithLayerType(unsigned TyID, int Idx, 
+		IDBitmap &FS) {
 
 	// Get the direct funcset in the current layer, which
 	// will be further unioned with other targets from type
 	// casting
+	FS.clear();
 	if (Idx == -1) {
-		for (auto FSet : typeIdxFuncsMap[TyHash]) {
-			FS.insert(FSet.second.begin(), FSet.second.end());
-		}
+		// All fields of the type
+		if (TyID >= frozenTypeIdxFuncs.size())
+			return true;
+		const IdxRange &R = frozenTypeIdxFuncs[TyID];
+		for (uint32_t i = R.Begin; i < R.End; ++i)
+			FS.unionWith(typeIdxFuncsMap[i].second);
 	}
 	else {
-		FS = typeIdxFuncsMap[TyHash][Idx];
-		FS.insert(typeIdxFuncsMap[TyHash][-1].begin(), 
-				typeIdxFuncsMap[TyHash][-1].end());
+		idxkey_t Keys[2] = {idxkey_c(TyID, Idx), idxkey_c(TyID, -1)};
+		for (idxkey_t Key : Keys) {
+			++Ctx->NumTypeTableLookups;
+			if (const IDBitmap *IF = typeIdxFuncsMap.lookup(Key)) {
+				++Ctx->NumTypeTableHits;
+				FS.unionWith(*IF);
+			}
+		}
 	}
 
 	return true;
 }
 
 // The API for MLTA: it returns functions for an indirect call
-bool MLTA::findCalleesWithMLTA(CallInst *CI, 
-		FuncSet &FS) {
+unsigned MLTA::findCalleesWithMLTA(CallInst *CI) {
 
 	// Initial set: first-layer results
 	// TODO: handling virtual functions
-	FS = Ctx->sigFuncsMap[callHash(CI)];
+	unsigned SigSetID = getSigTargetSet(callSigID(CI));
 
-	if (FS.empty()) {
+	if (Ctx->TargetSets.get(SigSetID).empty()) {
 		// No need to go through MLTA if the first layer is empty
-		return false;
+		return SigSetID;
 	}
 
-	FuncSet FS1, FS2;
+	// The targets are the interned set TargetsID until a layer
+	// narrows them. From then on they are owned by Targets and
+	// narrowed in place, so at most one set is copied per call.
+	unsigned TargetsID = SigSetID;
+	IDBitmap Targets;
+	bool Owned = false;
+	unsigned Copies = 0;
 	Type *PrevLayerTy = (dyn_cast<CallBase>(CI))->getFunctionType();
 	int PrevIdx = -1;
 	Value *CV = CI->getCalledOperand();
@@ -1279,7 +1647,7 @@ bool MLTA::findCalleesWithMLTA(CallInst *CI,
 	int LayerNo = 1;
 
 	// Get the next-layer type
-	list<typeidx_t> TyList;
+	typeidx_list_t TyList;
 	bool  ContinueNextLayer = true;
 	while (ContinueNextLayer) {
 
@@ -1288,13 +1656,12 @@ bool MLTA::findCalleesWithMLTA(CallInst *CI,
 			break;
 
 #ifdef SOUND_MODE
-		if (typeCapSet.find(typeHash(PrevLayerTy)) != typeCapSet.end()) {
+		if (isCapType(getTypeID(PrevLayerTy))) {
 			break;
 		}
 #endif
 
-		set<Value *> Visited;
-		nextLayerBaseType(CV, TyList, NextV, Visited);
+		nextLayerBaseTypeMemo(CV, TyList, NextV);
 		if (TyList.empty()) {
 			if (LayerNo == 1) {
 				//printSourceCodeInfo(CI, "NOBASE");
@@ -1312,24 +1679,23 @@ bool MLTA::findCalleesWithMLTA(CallInst *CI,
 				<<"; Idx: "<<TyIdx.second<<"\n";
 			DBG<<"[HASH] "<<typeHash(TyIdx.first)<<"\n";
 
-			size_t TyIdxHash = typeIdxHash(TyIdx.first, TyIdx.second);
+			unsigned TyID = getTypeID(TyIdx.first);
+			idxkey_t TyIdxKey = idxkey_c(TyID, TyIdx.second);
 			// -1 represents all possible fields of a struct
-			size_t TyIdxHash_1 = typeIdxHash(TyIdx.first, -1);
+			idxkey_t TyIdxKey_1 = idxkey_c(TyID, -1);
 
 			// Caching for performance
-			if (MatchedFuncsMap.find(TyIdxHash) != MatchedFuncsMap.end()) {
-				FS1 = MatchedFuncsMap[TyIdxHash];
+			unsigned LayerID;
+			if (const unsigned *SetID = MatchedFuncsMap.lookup(TyIdxKey)) {
+				LayerID = *SetID;
 			}
 			else {
 
 #ifdef SOUND_MODE
-				if (typeEscapeSet.find(TyIdxHash) 
-						!= typeEscapeSet.end()) {
-
+				if (frozenTypeEscapeSet.contains(TyIdxKey)) {
 					break;
 				}
-				if (typeEscapeSet.find(TyIdxHash_1) 
-						!= typeEscapeSet.end()) {
+				if (frozenTypeEscapeSet.contains(TyIdxKey_1)) {
 					break;
 				}
 #endif
@@ -1339,41 +1705,55 @@ bool MLTA::findCalleesWithMLTA(CallInst *CI,
 				// to continue, as all targets of previous layer are assumed to
 				// be propagated to the next layer.
 				if (PrevLayerTy) {
-					if ((typeIdxPropMap[typeHash(TyIdx.first)]
-								[TyIdx.second].find(hashidx_c(typeHash(PrevLayerTy), PrevIdx)) 
-								!= typeIdxPropMap[typeHash(TyIdx.first)]
+					if ((typeIdxPropMap[TyID]
+								[TyIdx.second].find(idxkey_c(getTypeID(PrevLayerTy), PrevIdx)) 
+								!= typeIdxPropMap[TyID]
 								[TyIdx.second].end()) ||
-							typeIdxPropMap[typeHash(TyIdx.first)]
-							[-1].find(hashidx_c(typeHash(PrevLayerTy), PrevIdx)) 
-							!= typeIdxPropMap[typeHash(TyIdx.first)]
+							typeIdxPropMap[TyID]
+							[-1].find(idxkey_c(getTypeID(PrevLayerTy), PrevIdx)) 
+							!= typeIdxPropMap[TyID]
 							[-1].end()) {
 						break;
 					}
 				}
 #endif
 
-				getTargetsWithLayerType(typeHash(TyIdx.first), TyIdx.second, FS1);
+				chrono::steady_clock::time_point Start;
+				if (TypeTableStats)
+					Start = chrono::steady_clock::now();
+
+				IDBitmap FS;
+				getTargetsWithLayerType(TyID, TyIdx.second, FS);
 
 				// Collect targets from dependent types that may propagate
 				// targets to it
-				set<hashidx_t> PropSet;
-				getDependentTypes(TyIdx.first, TyIdx.second, PropSet);
-				for (auto Prop : PropSet) {
-					getTargetsWithLayerType(Prop.first, Prop.second, FS2);
-					FS1.insert(FS2.begin(), FS2.end());
-				}
-				MatchedFuncsMap[TyIdxHash] = FS1;
+				FS.unionWith(Ctx->TargetSets.get(
+							getDependentTargets(TyID, TyIdx.second)));
+
+				if (TypeTableStats)
+					Ctx->TypeTableLookupTime += chrono::duration<double>(
+							chrono::steady_clock::now() - Start).count();
+
+				LayerID = Ctx->TargetSets.intern(std::move(FS));
+				MatchedFuncsMap.getOrInsert(TyIdxKey) = LayerID;
 			}
 
 			// Next layer may not always have a subset of the previous layer
 			// because of casting, so let's do intersection
-			intersectFuncSets(FS1, FS, FS2);
-			FS = FS2;
+			const IDBitmap &Layer = Ctx->TargetSets.get(LayerID);
+			if (Owned)
+				Targets.intersectWith(Layer);
+			else if (LayerID != TargetsID) {
+				Targets = Ctx->TargetSets.get(TargetsID);
+				Targets.intersectWith(Layer);
+				Owned = true;
+				++Copies;
+			}
 
 			CV = NextV;
 
 #ifdef SOUND_MODE
-			if (typeCapSet.find(typeHash(TyIdx.first)) != typeCapSet.end()) {
+			if (isCapType(TyID)) {
 				ContinueNextLayer = false;
 				break;
 			}
@@ -1385,22 +1765,29 @@ bool MLTA::findCalleesWithMLTA(CallInst *CI,
 		TyList.clear();
 	}
 
+	Ctx->NumResolutionSetCopies += Copies;
+	Ctx->MaxResolutionSetCopies = max(Ctx->MaxResolutionSetCopies, Copies);
+
 	if (LayerNo > 1) {
 		Ctx->NumSecondLayerTypeCalls++;
-		Ctx->NumSecondLayerTargets += FS.size();
+		Ctx->NumSecondLayerTargets += Owned ? Targets.size()
+			: Ctx->TargetSets.get(TargetsID).size();
 	}
 	else {
-		Ctx->NumFirstLayerTargets += Ctx->sigFuncsMap[callHash(CI)].size();
+		Ctx->NumFirstLayerTargets += Ctx->TargetSets.get(SigSetID).size();
 		Ctx->NumFirstLayerTypeCalls += 1;
 	}
 
 #if 0
-	FuncSet FSBase = Ctx->sigFuncsMap[callHash(CI)];
+	FuncSet FSBase;
+	insertFuncs(getSigFuncs(callSigID(CI)), FSBase);
 	saveCalleesInfo(CI, FSBase, false);
 	saveCalleesInfo(CI, FSBase, true);
 #endif
 
-	return true;
+	if (!Owned)
+		return TargetsID;
+	return Ctx->TargetSets.intern(std::move(Targets));
 }
 
 
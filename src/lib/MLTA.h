@@ -4,11 +4,56 @@
 #include "Analyzer.h"
 #include "Config.h"
 #include "llvm/IR/Operator.h"
+#include "FlatMap.h"
+#include "MembershipSet.h"
 
 typedef pair<Type *, int> typeidx_t;
 pair<Type *, int> typeidx_c(Type *Ty, int Idx);
-typedef pair<size_t, int> hashidx_t;
-pair<size_t, int> hashidx_c(size_t Hash, int Idx);
+// A (type ID, field index) pair packed into one integer
+typedef uint64_t idxkey_t;
+static inline idxkey_t idxkey_c(unsigned TyID, int Idx) {
+	return ((uint64_t)TyID << 32) | (uint32_t)Idx;
+}
+static inline unsigned idxkey_type(idxkey_t Key) {
+	return (unsigned)(Key >> 32);
+}
+static inline int idxkey_idx(idxkey_t Key) {
+	return (int)(uint32_t)Key;
+}
+
+// Layer types found by a walk; chains are rarely deeper than
+// MAX_TYPE_LAYER, so they stay inline
+typedef SmallVector<typeidx_t, MAX_TYPE_LAYER> typeidx_list_t;
+
+// Values visited by a walk, in visiting order, so that a walk can be
+// rolled back to an earlier point instead of copying the set
+class VisitSet {
+
+	public:
+		bool insert(Value *V) {
+			if (!Set.insert(V).second)
+				return false;
+			Order.push_back(V);
+			return true;
+		}
+		bool count(Value *V) const { return Set.count(V); }
+		void clear() { Set.clear(); Order.clear(); }
+
+		size_t mark() const { return Order.size(); }
+		void rollback(size_t Mark) {
+			while (Order.size() > Mark) {
+				Set.erase(Order.back());
+				Order.pop_back();
+			}
+		}
+		// Whether the walk outgrew the inline storage
+		bool spilled() const { return Order.capacity() > InlineSize; }
+
+	private:
+		enum { InlineSize = 16 };
+		SmallPtrSet<Value *, InlineSize> Set;
+		SmallVector<Value *, InlineSize> Order;
+};
 
 class MLTA {
 
@@ -25,19 +70,41 @@ class MLTA {
 		// Important data structures for type confinement, propagation,
 		// and escapes. 
 		////////////////////////////////////////////////////////////////
-		DenseMap<size_t, map<int, FuncSet>>typeIdxFuncsMap;
-		map<size_t, map<int, set<hashidx_t>>>typeIdxPropMap;
-		set<size_t>typeEscapeSet;
+		// All of them are keyed by type IDs of the type catalog, the
+		// first two by packed (type ID, idx) keys. Propagation
+		// sources may repeat until the tables are frozen.
+		FlatMap<IDBitmap>typeIdxFuncsMap;
+		FlatMap<vector<idxkey_t>>typeIdxPropMap;
+		ConcurrentKeySet typeEscapeSet;
 		// Cap type: We cannot know where the type can be futher
-		// propagated to. Do not include idx in the hash
-		set<size_t>typeCapSet;
+		// propagated to. Do not include idx in the key
+		ConcurrentKeySet typeCapSet;
+
+
+		////////////////////////////////////////////////////////////////
+		// Read-only versions of the above, frozen after phase 1. The
+		// entries of typeIdxFuncsMap are sorted by key, and each type
+		// ID indexes the range of its entries. The propagation graph
+		// is replaced by the set IDs of the dependent targets of every
+		// (type, idx) with sources.
+		////////////////////////////////////////////////////////////////
+		struct IdxRange {
+			uint32_t Begin = 0;
+			uint32_t End = 0;
+		};
+		vector<IdxRange>frozenTypeIdxFuncs;
+		FlatMap<unsigned>frozenTypeIdxDeps;
+		MembershipSet frozenTypeEscapeSet;
+		// Type IDs are dense, so caps are one bit per type
+		BitVector frozenTypeCapSet;
 
 
 		////////////////////////////////////////////////////////////////
 		// Other data structures
 		////////////////////////////////////////////////////////////////
-		// Cache matched functions for CallInst
-		DenseMap<size_t, FuncSet>MatchedFuncsMap;
+		// Cache matched functions for (type, idx) layers. All cached
+		// sets are IDs of Ctx->TargetSets
+		FlatMap<unsigned>MatchedFuncsMap;
 		DenseMap<Value *, FuncSet>VTableFuncsMap;
 
 		set<size_t>srcLnHashSet;
@@ -46,8 +113,36 @@ class MLTA {
 		map<size_t, set<size_t>>calleesSrcMap;
 		map<size_t, set<size_t>>L1CalleesSrcMap;
 
-		// Matched icall types -- to avoid repeatation
-		DenseMap<size_t, FuncSet> MatchedICallTypeMap;
+		// Matched icall types -- to avoid repeatation. Indexed by
+		// signature ID
+		DenseMap<unsigned, unsigned> MatchedICallTypeMap;
+
+		// Index of the address-taken functions for fuzzy type matching,
+		// built on first use. Non-variadic functions are bucketed by
+		// arity and the coarse classes of their return and argument
+		// types, since fuzzily matching types have the same class.
+		// Variadic functions are checked one by one.
+		struct FuzzyCand {
+			Function *F;
+			unsigned DefID;
+		};
+		FlatMap<vector<FuzzyCand>>fuzzyFuncBuckets;
+		vector<FuzzyCand>fuzzyVarArgFuncs;
+		bool fuzzyIndexBuilt = false;
+		// Results of fuzzyTypeMatch; a type decides its module
+		DenseMap<pair<Type *, Type *>, bool>fuzzyMatchCache;
+		// Target set of each signature ID, interned after phase 1
+		vector<unsigned>sigTargetSets;
+
+		// Signature interning: every function type gets a dense ID
+		// once; types with the same signature hash share the ID
+		DenseMap<FunctionType *, unsigned>funcTypeSigIDs;
+		DenseMap<size_t, unsigned>sigHashIDs;
+
+		// Type catalog: every distinct type identity across all
+		// modules gets a dense ID
+		DenseMap<Type *, unsigned>typeIDs;
+		DenseMap<size_t, unsigned>typeHashIDs;
 
 		// Set of target types
 		set<size_t>TTySet;
@@ -57,8 +152,36 @@ class MLTA {
 		// Special functions like syscalls
 		FuncSet OutScopeFuncs;
 
-		// Alias struct pointer of a general pointer
-		map<Function *, map<Value *, Value *>>AliasStructPtrMap;
+		// Scratch buffers of typeConfineInInitializer, reused across
+		// globals and reset at the start of each one. The type IDs of
+		// every container type of the global are computed once and
+		// kept as ranges of InitTyIDPool.
+		DenseMap<Value *, pair<Value *, int>>InitContainers;
+		DenseMap<Type *, pair<unsigned, unsigned>>InitContainerTyIDs;
+		vector<unsigned>InitTyIDPool;
+		vector<User *>InitWorklist;
+		SmallPtrSet<Value *, 32>InitVisited;
+		SmallPtrSet<Value *, 8>InitChainVisited;
+
+		// Alias struct pointers of general pointers in one function,
+		// sorted by the general pointer. They are computed when the
+		// function is first needed and evicted once it is done.
+		Function *AliasFunc = NULL;
+		vector<pair<Value *, Value *>>AliasStructPtrs;
+		// Results of the walks from values of one function, shared by
+		// its confinement, propagation and resolution; the walks only
+		// read the IR. The layer types are ranges of WalkTypes. Chains
+		// are from getBaseTypeChain() with their completeness, layers
+		// from one fresh nextLayerBaseType() with its return value.
+		struct WalkResult {
+			uint32_t Begin;
+			uint32_t Len;
+			Value *NextV;
+			bool Flag;
+		};
+		DenseMap<Value *, WalkResult>ChainMemo;
+		DenseMap<Value *, WalkResult>LayerMemo;
+		vector<typeidx_t>WalkTypes;
 
 
 
@@ -70,33 +193,85 @@ class MLTA {
 		// Type-related basic functions
 		////////////////////////////////////////////////////////////////
 		bool fuzzyTypeMatch(Type *Ty1, Type *Ty2, Module *M1, Module *M2);
+		bool _fuzzyTypeMatch(Type *Ty1, Type *Ty2, Module *M1, Module *M2);
+		void buildFuzzyIndex();
 
 		void escapeType(Value *V);
 		void propagateType(Value *ToV, Type *FromTy, int Idx = -1);
 
-		Type *getBaseType(Value *V, set<Value *> &Visited);
-		Type *_getPhiBaseType(PHINode *PN, set<Value *> &Visited);
+		Type *getBaseType(Value *V, VisitSet &Visited);
+		Type *_getPhiBaseType(PHINode *PN, VisitSet &Visited);
 		Function *getBaseFunction(Value *V);
-		bool nextLayerBaseType(Value *V, list<typeidx_t> &TyList, 
-				Value * &NextV, set<Value *> &Visited);
-		bool nextLayerBaseTypeWL(Value *V, list<typeidx_t> &TyList, 
+		bool nextLayerBaseType(Value *V, typeidx_list_t &TyList, 
+				Value * &NextV, VisitSet &Visited);
+		bool nextLayerBaseTypeWL(Value *V, typeidx_list_t &TyList, 
 				Value * &NextV);
-		bool getGEPLayerTypes(GEPOperator *GEP, list<typeidx_t> &TyList);
-		bool getBaseTypeChain(list<typeidx_t> &Chain, Value *V, 
+		// nextLayerBaseType() from a fresh walk, memoized per function
+		bool nextLayerBaseTypeMemo(Value *V, typeidx_list_t &TyList, 
+				Value * &NextV);
+		bool getGEPLayerTypes(GEPOperator *GEP, typeidx_list_t &TyList);
+		bool getBaseTypeChain(typeidx_list_t &Chain, Value *V, 
 				bool &Complete);
-		bool getDependentTypes(Type *Ty, int Idx, set<hashidx_t> &PropSet);
+		// Count a finished walk for the statistics
+		void countWalk(const VisitSet &Visited, const typeidx_list_t &TyList);
+		unsigned getDependentTargets(unsigned TyID, int Idx);
 
 
 		////////////////////////////////////////////////////////////////
 		// Target-related basic functions
 		////////////////////////////////////////////////////////////////
 		void confineTargetFunction(Value *V, Function *F);
-		void intersectFuncSets(FuncSet &FS1, FuncSet &FS2,
-				FuncSet &FS); 
 		bool typeConfineInInitializer(GlobalVariable *GV);
+		ArrayRef<unsigned> getContainerTyIDs(Type *CTy);
 		bool typeConfineInFunction(Function *F);
 		bool typePropInFunction(Function *F);
 		void collectAliasStructPtr(Function *F);
+		// Drop the per-function caches once a function is done
+		void evictFunctionCaches();
+
+		////////////////////////////////////////////////////////////////
+		// Symbol resolution
+		////////////////////////////////////////////////////////////////
+		void resolveSymbols();
+		Function *getFuncDefinition(Function *F);
+
+		// Compile the phase-1 maps into the read-only tables
+		void freezeTypeTables();
+		void condenseTypePropagation();
+
+		////////////////////////////////////////////////////////////////
+		// Signatures
+		////////////////////////////////////////////////////////////////
+		unsigned getSigID(FunctionType *FTy);
+		unsigned funcSigID(Function *F) {
+			return getSigID(F->getFunctionType());
+		}
+		unsigned callSigID(CallInst *CI) {
+			return getSigID(CI->getFunctionType());
+		}
+		unsigned getSigTargetSet(unsigned SigID);
+		const IDBitmap &getSigFuncs(unsigned SigID) {
+			return Ctx->TargetSets.get(getSigTargetSet(SigID));
+		}
+
+		////////////////////////////////////////////////////////////////
+		// Function IDs
+		////////////////////////////////////////////////////////////////
+		unsigned getFuncID(Function *F);
+		Function *getFuncByID(unsigned ID) {
+			return Ctx->IDFuncs[ID];
+		}
+		// Add the functions of a bitmap to FS
+		void insertFuncs(const IDBitmap &IDs, FuncSet &FS);
+
+		////////////////////////////////////////////////////////////////
+		// Type catalog
+		////////////////////////////////////////////////////////////////
+		unsigned getTypeID(Type *Ty);
+		unsigned getTypeHashID(size_t TyHash);
+		bool isCapType(unsigned TyID) {
+			return TyID < frozenTypeCapSet.size() && frozenTypeCapSet.test(TyID);
+		}
 
 		// deprecated 
 		//bool typeConfineInStore(StoreInst *SI);
@@ -108,10 +283,11 @@ class MLTA {
 		// API functions
 		////////////////////////////////////////////////////////////////
 		// Use type-based analysis to find targets of indirect calls
-		void findCalleesWithType(CallInst*, FuncSet&);
-		bool findCalleesWithMLTA(CallInst *CI, FuncSet &FS);
-		bool getTargetsWithLayerType(size_t TyHash, int Idx, 
-				FuncSet &FS);
+		// Both return the ID of the target set in Ctx->TargetSets
+		unsigned findCalleesWithType(CallInst *CI);
+		unsigned findCalleesWithMLTA(CallInst *CI);
+		bool getTargetsWithLayerType(unsigned TyID, int Idx, 
+				IDBitmap &FS);
 
 
 		////////////////////////////////////////////////////////////////
@@ -120,10 +296,9 @@ class MLTA {
 		bool isCompositeType(Type *Ty);
 		Type *getFuncPtrType(Value *V);
 		Value *recoverBaseType(Value *V);
-		void unrollLoops(Function *F);
 		void saveCalleesInfo(CallInst *CI, FuncSet &FS, bool mlta);
-		void printTargets(FuncSet &FS, CallInst *CI = NULL);
-		void printTypeChain(list<typeidx_t> &Chain);
+		void printTargets(const IDBitmap &FS, CallInst *CI = NULL);
+		void printTypeChain(typeidx_list_t &Chain);
 
 
 	public:
@@ -0,0 +1,84 @@
+//===-- MembershipSet.cc - Compact read-only key sets -----------===//
+//
+// Builds the sorted key array and the blocked bloom filter of
+// MembershipSet, and collects its keys concurrently.
+//
+//===-----------------------------------------------------------===//
+
+#include <algorithm>
+
+#include "MembershipSet.h"
+#include "PerfectHash.h"
+
+// Bits of the bloom filter per key
+#define BLOOM_BITS_PER_KEY 12
+// Bits of a bloom block
+#define BLOOM_BLOCK_BITS 256
+
+// The block of a hash, from its high half
+static inline uint64_t bloomBlock(uint64_t H, uint64_t NumBlocks) {
+	return ((H >> 32) * NumBlocks) >> 32;
+}
+
+// The bit of a hash in word i of its block, from its low half
+static inline uint64_t bloomBit(uint64_t H, unsigned i) {
+	return 1ULL << ((H >> (i * 6)) & 63);
+}
+
+void MembershipSet::build(vector<uint64_t> InKeys) {
+
+	sort(InKeys.begin(), InKeys.end());
+	InKeys.erase(unique(InKeys.begin(), InKeys.end()), InKeys.end());
+	InKeys.shrink_to_fit();
+	Keys.swap(InKeys);
+
+	NumBlocks = Keys.size() * BLOOM_BITS_PER_KEY / BLOOM_BLOCK_BITS + 1;
+	Bloom.assign(NumBlocks * 4, 0);
+	for (uint64_t Key : Keys) {
+		uint64_t H = mixHash64(Key);
+		uint64_t *Block = &Bloom[bloomBlock(H, NumBlocks) * 4];
+		for (unsigned i = 0; i < 4; ++i)
+			Block[i] |= bloomBit(H, i);
+	}
+}
+
+bool MembershipSet::contains(uint64_t Key) const {
+
+	if (Keys.empty())
+		return false;
+
+	uint64_t H = mixHash64(Key);
+	const uint64_t *Block = &Bloom[bloomBlock(H, NumBlocks) * 4];
+	for (unsigned i = 0; i < 4; ++i) {
+		if (!(Block[i] & bloomBit(H, i)))
+			return false;
+	}
+
+	return binary_search(Keys.begin(), Keys.end(), Key);
+}
+
+void MembershipSet::clear() {
+	Keys.clear();
+	Keys.shrink_to_fit();
+	Bloom.clear();
+	Bloom.shrink_to_fit();
+	NumBlocks = 0;
+}
+
+void ConcurrentKeySet::insert(uint64_t Key) {
+
+	Shard &S = Shards[mixHash64(Key) % NUM_SHARDS];
+	lock_guard<mutex> Guard(S.Lock);
+	S.Keys.insert(Key);
+}
+
+vector<uint64_t> ConcurrentKeySet::takeKeys() {
+
+	vector<uint64_t> Keys;
+	for (Shard &S : Shards) {
+		lock_guard<mutex> Guard(S.Lock);
+		Keys.insert(Keys.end(), S.Keys.begin(), S.Keys.end());
+		S.Keys = llvm::DenseSet<uint64_t>();
+	}
+	return Keys;
+}
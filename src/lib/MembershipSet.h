@@ -0,0 +1,65 @@
+#ifndef _MEMBERSHIP_SET_H
+#define _MEMBERSHIP_SET_H
+
+#include <llvm/ADT/DenseSet.h>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+using namespace std;
+
+//
+// Read-only set of 64-bit keys for membership checks on hot paths.
+// The keys are kept in one sorted array, and a blocked bloom filter
+// in front of it rejects most non-members with a single cache line:
+// every key sets one bit in each word of a 256-bit block.
+//
+class MembershipSet {
+
+	public:
+		// Build from keys in any order; duplicates are allowed
+		void build(vector<uint64_t> InKeys);
+
+		bool contains(uint64_t Key) const;
+
+		size_t size() const { return Keys.size(); }
+		bool empty() const { return Keys.empty(); }
+
+		size_t getMemorySize() const {
+			return Keys.capacity() * sizeof(uint64_t)
+				+ Bloom.capacity() * sizeof(uint64_t);
+		}
+
+		void clear();
+
+	private:
+		vector<uint64_t> Keys;
+		// Four words per block
+		vector<uint64_t> Bloom;
+		uint64_t NumBlocks = 0;
+};
+
+//
+// Set of 64-bit keys that may be inserted from several threads,
+// used to collect the keys of a MembershipSet. The keys are split
+// into shards by hash, each with its own lock.
+//
+class ConcurrentKeySet {
+
+	public:
+		void insert(uint64_t Key);
+
+		// All keys, in no particular order; the set is emptied
+		vector<uint64_t> takeKeys();
+
+	private:
+		static const unsigned NUM_SHARDS = 16;
+
+		struct Shard {
+			mutex Lock;
+			llvm::DenseSet<uint64_t> Keys;
+		};
+		Shard Shards[NUM_SHARDS];
+};
+
+#endif
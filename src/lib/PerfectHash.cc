@@ -0,0 +1,143 @@
+//===-- PerfectHash.cc - Read-only perfect-hash tables ----------===//
+//
+// Builds the minimal perfect hash index used by the frozen tables.
+//
+//===-----------------------------------------------------------===//
+
+#include <algorithm>
+#include <cassert>
+
+#include "PerfectHash.h"
+
+// Average number of keys per bucket
+#define KEYS_PER_BUCKET 4
+// Seeds to try for a bucket before the table is enlarged
+#define MAX_SEED_TRIES (1U << 20)
+// A seed with this bit set directly stores the slot of a
+// single-key bucket
+#define DIRECT_SLOT (1U << 31)
+
+// Map a 64-bit hash to [0, N) without division
+static inline uint64_t reduceRange(uint64_t H, uint64_t N) {
+	return (uint64_t)(((__uint128_t)H * N) >> 64);
+}
+
+uint64_t PerfectHashIndex::bucketOf(uint64_t Key) const {
+	return reduceRange(mixHash64(Key), Seeds.size());
+}
+
+uint64_t PerfectHashIndex::slotOf(uint64_t Key, uint32_t Seed) const {
+	if (Seed & DIRECT_SLOT)
+		return Seed & ~DIRECT_SLOT;
+	uint64_t H = mixHash64(Key ^ mixHash64(Seed + 0x9e3779b97f4a7c15ULL));
+	return reduceRange(H, Keys.size());
+}
+
+bool PerfectHashIndex::tryBuild(const vector<uint64_t> &InKeys,
+		vector<uint32_t> &SlotOf, size_t NumSlots) {
+
+	size_t NumBuckets = InKeys.size() / KEYS_PER_BUCKET + 1;
+	Seeds.assign(NumBuckets, 0);
+	Keys.assign(NumSlots, 0);
+	Used.clear();
+	Used.resize(NumSlots);
+	SlotOf.assign(InKeys.size(), 0);
+
+	// Group the keys by bucket
+	vector<vector<uint32_t>> Buckets(NumBuckets);
+	for (uint32_t i = 0; i < InKeys.size(); ++i)
+		Buckets[bucketOf(InKeys[i])].push_back(i);
+
+	// Place the largest buckets first, while the table is still
+	// sparse
+	vector<uint32_t> Order(NumBuckets);
+	for (uint32_t b = 0; b < NumBuckets; ++b)
+		Order[b] = b;
+	stable_sort(Order.begin(), Order.end(),
+			[&Buckets](uint32_t A, uint32_t B) {
+			return Buckets[A].size() > Buckets[B].size();
+			});
+
+	vector<uint64_t> Slots;
+	size_t NextFree = 0;
+	for (uint32_t b : Order) {
+		vector<uint32_t> &Bucket = Buckets[b];
+		if (Bucket.empty())
+			break;
+
+		// Single-key buckets take the next free slot directly
+		if (Bucket.size() == 1) {
+			while (Used.test(NextFree))
+				++NextFree;
+			Seeds[b] = DIRECT_SLOT | NextFree;
+			Used.set(NextFree);
+			Keys[NextFree] = InKeys[Bucket[0]];
+			SlotOf[Bucket[0]] = NextFree;
+			continue;
+		}
+
+		bool Placed = false;
+		for (uint32_t Seed = 0; Seed < MAX_SEED_TRIES; ++Seed) {
+			Slots.clear();
+			bool Free = true;
+			for (uint32_t i : Bucket) {
+				uint64_t S = slotOf(InKeys[i], Seed);
+				if (Used.test(S)
+						|| find(Slots.begin(), Slots.end(), S) != Slots.end()) {
+					Free = false;
+					break;
+				}
+				Slots.push_back(S);
+			}
+			if (!Free)
+				continue;
+
+			Seeds[b] = Seed;
+			for (unsigned j = 0; j < Bucket.size(); ++j) {
+				Used.set(Slots[j]);
+				Keys[Slots[j]] = InKeys[Bucket[j]];
+				SlotOf[Bucket[j]] = Slots[j];
+			}
+			Placed = true;
+			break;
+		}
+		if (!Placed)
+			return false;
+	}
+
+	return true;
+}
+
+void PerfectHashIndex::build(const vector<uint64_t> &InKeys,
+		vector<uint32_t> &SlotOf) {
+
+	NumKeys = InKeys.size();
+	assert(NumKeys < DIRECT_SLOT);
+
+	// Start with a minimal table and give it more room in the
+	// unlikely case that a bucket cannot be placed
+	size_t NumSlots = NumKeys ? NumKeys : 1;
+	while (!tryBuild(InKeys, SlotOf, NumSlots))
+		NumSlots += NumSlots / 16 + 1;
+}
+
+int64_t PerfectHashIndex::lookup(uint64_t Key) const {
+
+	if (!NumKeys)
+		return -1;
+
+	uint64_t Slot = slotOf(Key, Seeds[bucketOf(Key)]);
+	if (Used.test(Slot) && Keys[Slot] == Key)
+		return Slot;
+
+	return -1;
+}
+
+void PerfectHashIndex::clear() {
+	Seeds.clear();
+	Seeds.shrink_to_fit();
+	Keys.clear();
+	Keys.shrink_to_fit();
+	Used.clear();
+	NumKeys = 0;
+}
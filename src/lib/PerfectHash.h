@@ -0,0 +1,108 @@
+#ifndef _PERFECT_HASH_H
+#define _PERFECT_HASH_H
+
+#include <llvm/ADT/BitVector.h>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+using namespace std;
+
+//
+// Read-only tables based on minimal perfect hashing (hash and
+// displace). Keys are first split into small buckets; every bucket
+// then gets a seed that moves all of its keys into free slots. A
+// lookup is one probe into the seeds and one into the slots, and
+// the values are kept in one contiguous array.
+//
+
+// 64-bit finalizer of splitmix64
+static inline uint64_t mixHash64(uint64_t X) {
+	X ^= X >> 30;
+	X *= 0xbf58476d1ce4e5b9ULL;
+	X ^= X >> 27;
+	X *= 0x94d049bb133111ebULL;
+	X ^= X >> 31;
+	return X;
+}
+
+class PerfectHashIndex {
+
+	public:
+		// Build the index for distinct keys; SlotOf[i] is the slot
+		// assigned to InKeys[i]
+		void build(const vector<uint64_t> &InKeys,
+				vector<uint32_t> &SlotOf);
+
+		// The slot of Key, or -1 if Key is not in the table
+		int64_t lookup(uint64_t Key) const;
+
+		size_t numSlots() const { return Keys.size(); }
+		size_t size() const { return NumKeys; }
+
+		size_t getMemorySize() const {
+			return Seeds.capacity() * sizeof(uint32_t)
+				+ Keys.capacity() * sizeof(uint64_t)
+				+ Used.getMemorySize();
+		}
+
+		void clear();
+
+	private:
+		vector<uint32_t> Seeds;
+		vector<uint64_t> Keys;
+		llvm::BitVector Used;
+		size_t NumKeys = 0;
+
+		uint64_t bucketOf(uint64_t Key) const;
+		uint64_t slotOf(uint64_t Key, uint32_t Seed) const;
+		bool tryBuild(const vector<uint64_t> &InKeys,
+				vector<uint32_t> &SlotOf, size_t NumSlots);
+};
+
+template <typename ValueT>
+class FrozenMap {
+
+	public:
+		// Build the table; the values are moved out of Entries
+		void build(vector<pair<uint64_t, ValueT>> &Entries) {
+			vector<uint64_t> InKeys;
+			vector<uint32_t> SlotOf;
+			InKeys.reserve(Entries.size());
+			for (auto &E : Entries)
+				InKeys.push_back(E.first);
+			Index.build(InKeys, SlotOf);
+
+			Values.clear();
+			Values.resize(Index.numSlots());
+			for (size_t i = 0; i < Entries.size(); ++i)
+				Values[SlotOf[i]] = std::move(Entries[i].second);
+		}
+
+		const ValueT *lookup(uint64_t Key) const {
+			int64_t Slot = Index.lookup(Key);
+			if (Slot < 0)
+				return NULL;
+			return &Values[Slot];
+		}
+
+		size_t size() const { return Index.size(); }
+		bool empty() const { return Index.size() == 0; }
+
+		size_t getMemorySize() const {
+			return Index.getMemorySize()
+				+ Values.capacity() * sizeof(ValueT);
+		}
+
+		void clear() {
+			Index.clear();
+			Values.clear();
+			Values.shrink_to_fit();
+		}
+
+	private:
+		PerfectHashIndex Index;
+		vector<ValueT> Values;
+};
+
+#endif
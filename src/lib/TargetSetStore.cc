@@ -0,0 +1,59 @@
+//===-- TargetSetStore.cc - Hash-consed target sets -----------===//
+//
+// Interning of the immutable target sets.
+//
+//===-----------------------------------------------------------===//
+
+#include "TargetSetStore.h"
+
+unsigned TargetSetStore::find(const IDBitmap &S, uint64_t Hash) const {
+
+	auto it = Index.find(Hash);
+	if (it == Index.end())
+		return 0;
+
+	for (unsigned ID : it->second) {
+		if (Sets[ID] == S)
+			return ID;
+	}
+	return 0;
+}
+
+unsigned TargetSetStore::intern(const IDBitmap &S) {
+
+	if (S.empty())
+		return 0;
+
+	uint64_t Hash = S.hash();
+	if (unsigned ID = find(S, Hash))
+		return ID;
+
+	unsigned ID = Sets.size();
+	Sets.push_back(S);
+	Index[Hash].push_back(ID);
+	return ID;
+}
+
+unsigned TargetSetStore::intern(IDBitmap &&S) {
+
+	if (S.empty())
+		return 0;
+
+	uint64_t Hash = S.hash();
+	if (unsigned ID = find(S, Hash))
+		return ID;
+
+	unsigned ID = Sets.size();
+	Sets.push_back(std::move(S));
+	Index[Hash].push_back(ID);
+	return ID;
+}
+
+size_t TargetSetStore::getMemorySize() const {
+
+	size_t Size = Sets.capacity() * sizeof(IDBitmap)
+		+ Index.getMemorySize();
+	for (const IDBitmap &S : Sets)
+		Size += S.getMemorySize();
+	return Size;
+}
@@ -0,0 +1,42 @@
+#ifndef _TARGET_SET_STORE_H
+#define _TARGET_SET_STORE_H
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+
+#include "IDBitmap.h"
+
+//
+// Hash-consing store of immutable target sets. Every distinct set is
+// kept once and referred to by its ID, so equal sets have equal IDs.
+// ID 0 is the empty set.
+//
+class TargetSetStore {
+
+	public:
+		TargetSetStore() {
+			Sets.push_back(IDBitmap());
+		}
+
+		// Get the ID of the canonical copy of S
+		unsigned intern(const IDBitmap &S);
+		unsigned intern(IDBitmap &&S);
+
+		const IDBitmap &get(unsigned ID) const {
+			return Sets[ID];
+		}
+
+		// Number of distinct sets
+		size_t size() const { return Sets.size(); }
+		size_t getMemorySize() const;
+
+	private:
+		vector<IDBitmap> Sets;
+		// Set hash -> IDs of the sets with the hash
+		llvm::DenseMap<uint64_t, llvm::SmallVector<unsigned, 1>> Index;
+
+		// ID of a set equal to S, or 0 if there is none
+		unsigned find(const IDBitmap &S, uint64_t Hash) const;
+};
+
+#endif